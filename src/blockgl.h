@@ -3,6 +3,7 @@
 
 #define STB_PERLIN_IMPLEMENTATION
 #include <stb_perlin.h>
+#include "noise.h"
 
 /*
 //BGL for short BlockGL
@@ -20,23 +21,30 @@ const unsigned int BGL_LoadSize = BGL_LoadRadius * 2 + 1;
 const unsigned int BGL_MaxFaces = (BGL_ChunkSize * BGL_ChunkSize * BGL_ChunkSize) * 6; //Max number of possible faces in a chunk // <----- Temporary
 */
 
-#define		BGL_ChunkSize					16
-#define		BGL_LoadRadius				7
+#define		BGL_DefaultChunkSize	16 // Chunk sizes with specialized code are 16, 32 and 64, see chunksize.h
+#define		BGL_MaxChunkSize			64
+#define		BGL_LoadRadius				7 // Default for both the horizontal and vertical radius at the default chunk size
+#define		BGL_MinLoadRadius			2
+#define		BGL_MaxLoadRadius			32 // Vertices only hold the chunk position modulo 256
 #define		BGL_MouseSensitivity	0.05f
 #define		BGL_TextureSize				16
 #define		BGL_BlockCount				6 // Air counts for one
 #define		BGL_TextureCount		 	6
+#define		BGL_MaxWorkerThreads	16
+
+#define BGL_Stringify(x) #x
+#define BGL_ToString(x) BGL_Stringify(x)
+#define BGL_Concat(a, b) a##b
+#define BGL_Concat2(a, b) BGL_Concat(a, b) // Expands macro arguments before pasting
 
 // Calculated constants
-#define BGL_LoadSize BGL_LoadRadius * 2 + 1
-//const unsigned int BGL_MaxFaces = (BGL_ChunkSize * BGL_ChunkSize * BGL_ChunkSize + 1) / 2; //Max number of possible faces in a chunk
-#define BGL_MaxFaces (BGL_ChunkSize * BGL_ChunkSize * BGL_ChunkSize) * 6 //Max number of possible faces in a chunk // <----- Temporary
+// Max number of possible faces in a chunk: a checkerboard of blocks with all 6 faces open
+#define BGL_MaxFaces(size) ((size) * (size) * (size) / 2 * 6)
 
+// Vertices are packed into two integers, see addQuad()
 static const char* vertex_shader_text =
 		"#version 330 core\n"
-				"layout (location = 0) in vec3 position;\n"
-				"layout (location = 1) in vec3 texCoord;\n"
-				"layout (location = 2) in vec3 normal;\n"
+				"layout (location = 0) in uvec2 packedVertex;\n"
 				"\n"
 				"out vec3 TexCoord;\n"
 				"out vec3 Normal;\n"
@@ -46,16 +54,33 @@ static const char* vertex_shader_text =
 				"\n"
 				"uniform mat4 view;\n"
 				"uniform mat4 projection;\n"
+				"uniform ivec3 cameraChunk;\n"
+				"uniform int chunkSize;\n"
 				"\n"
 				"const float gradient = 20;\n"
 				"const float density = 0.011;\n"
 				"\n"
+				"const vec3 normals[6] = vec3[6](vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1));\n"
+				"// Texture u and v axes of each face, and whether the texture runs along or against them\n"
+				"const ivec2 textureAxes[6] = ivec2[6](ivec2(2, 1), ivec2(2, 1), ivec2(0, 2), ivec2(0, 2), ivec2(0, 1), ivec2(0, 1));\n"
+				"const vec2 textureSigns[6] = vec2[6](vec2(-1, -1), vec2(1, -1), vec2(1, 1), vec2(-1, 1), vec2(1, -1), vec2(-1, -1));\n"
+				"\n"
 				"void main() {\n"
+				"\tuint data = packedVertex.x;\n"
+				"\tvec3 corner = vec3(float(data & 127u), float((data >> 7) & 127u), float((data >> 14) & 127u));\n"
+				"\tuint face = (data >> 21) & 7u;\n"
+				"\t// The low 8 bits of the chunk position are unique within 128 chunks of the camera\n"
+				"\tivec3 chunkBits = ivec3((uvec3(packedVertex.y) >> uvec3(8u, 16u, 24u)) & 255u);\n"
+				"\tivec3 chunk = cameraChunk + ((chunkBits - cameraChunk + 128) & 255) - 128;\n"
+				"\tvec3 position = vec3(chunk * chunkSize) + corner - 0.5;\n"
+				"\t\n"
 				"\tvec4 positionRelativeToCam = view * vec4(position, 1.0f);\n"
 				"\tgl_Position = projection * positionRelativeToCam;\n"
-				"\tTexCoord = texCoord;\n"
+				"\t// The texture repeats every block, so following the corner along the face axes gives the same texels as\n"
+				"\t// counting from the quad's first corner\n"
+				"\tTexCoord = vec3(vec2(corner[textureAxes[face].x], corner[textureAxes[face].y]) * textureSigns[face], float(packedVertex.y & 255u));\n"
 				"\tFragPos = position;\n"
-				"\tNormal = normal;\n"
+				"\tNormal = normals[face];\n"
 				"\t\n"
 				"\tfloat distance = length(positionRelativeToCam.xyz);\n"
 				"\tVisibility = exp(-pow((distance * density), gradient));\n"
@@ -132,47 +157,554 @@ int modulo(int x,int N){
 	return (x % N + N) %N;
 }
 
-struct Vec3i toChunkPos(const vec3 v) {
+struct Vec3i toChunkPos(const vec3 v, unsigned int chunkSize) {
 	struct Vec3i chunkPos;
-	chunkPos.x = (int)floor(v[0] / (float)BGL_ChunkSize);
-	chunkPos.y = (int)floor(v[1] / (float)BGL_ChunkSize);
-	chunkPos.z = (int)floor(v[2] / (float)BGL_ChunkSize);
+	chunkPos.x = (int)floor(v[0] / (float)chunkSize);
+	chunkPos.y = (int)floor(v[1] / (float)chunkSize);
+	chunkPos.z = (int)floor(v[2] / (float)chunkSize);
 	return chunkPos;
 }
 
-struct Vec3i toMemoryPos(const struct Vec3i v) {
-	struct Vec3i pos;
-	pos.x = modulo(v.x, BGL_LoadSize);
-	pos.y = modulo(v.y, BGL_LoadSize);
-	pos.z = modulo(v.z, BGL_LoadSize);
-	return pos;
+// The load shape is a cylinder, horizontally rounded so the corners that fog hides anyway aren't loaded
+bool isWithinRadius(const struct Vec3i v, const struct Vec3i center, const struct Vec3i radius) {
+	int dx = v.x - center.x, dz = v.z - center.z;
+	return abs(v.y - center.y) <= radius.y && dx * dx + dz * dz <= radius.x * radius.x + radius.x;
 }
 
 struct Block {
-	unsigned char id;
+	unsigned short id;
+};
+
+/*
+ * The blocks of a chunk are kept as indices into a palette of the ids in use, packed into 32-bit words at 0, 1, 2, 4,
+ * 8 or 16 bits per block so an index never straddles two words. A chunk of a single id stores no indices at all, and
+ * the index width doubles whenever a new id doesn't fit the palette anymore.
+ */
+struct BlockStorage {
+	unsigned short* palette;
+	unsigned int paletteSize;
+	unsigned int bits; // Per block, 0 when the palette holds a single id
+	uint32_t* words; // NULL when bits is 0
+	unsigned int size; // Chunk size, the storage holds size^3 blocks
+};
+
+/*
+ * Order of the blocks of a chunk in memory, chosen at build time with -DBGL_BlockLayout. Linear layouts are named from
+ * the slowest to the fastest varying axis. Morton order interleaves the bits of all three axes, so neighbours along
+ * any axis tend to share a cache line, and needs a power of two chunk size, which all supported sizes are.
+ */
+#define BGL_LayoutXYZ		0
+#define BGL_LayoutXZY		1 // Vertical columns are contiguous
+#define BGL_LayoutYZX		2 // Horizontal layers are contiguous
+#define BGL_LayoutMorton	3
+
+#ifndef BGL_BlockLayout
+#define BGL_BlockLayout BGL_LayoutXZY
+#endif
+
+// The low 6 bits of v with two zero bits after each of them, looked up since it runs for every block access
+#define BGL_SpreadBits(v) (((v) & 1) | ((v) & 2) << 2 | ((v) & 4) << 4 | ((v) & 8) << 6 | ((v) & 16) << 8 | ((v) & 32) << 10)
+#define BGL_SpreadBits4(v) BGL_SpreadBits(v), BGL_SpreadBits(v + 1), BGL_SpreadBits(v + 2), BGL_SpreadBits(v + 3)
+#define BGL_SpreadBits16(v) BGL_SpreadBits4(v), BGL_SpreadBits4(v + 4), BGL_SpreadBits4(v + 8), BGL_SpreadBits4(v + 12)
+static const unsigned short spreadBits[64] = {BGL_SpreadBits16(0), BGL_SpreadBits16(16), BGL_SpreadBits16(32), BGL_SpreadBits16(48)};
+
+// The specialized chunk code defines BGL_ChunkSize as a constant, see chunksize.h
+#define BGL_ForEach3(a, b, c) \
+		for(int a = 0; a < BGL_ChunkSize; a++) for(int b = 0; b < BGL_ChunkSize; b++) for(int c = 0; c < BGL_ChunkSize; c++)
+
+// BGL_ForEachBlock(x, y, z) nests loops over a chunk with the fastest varying axis of the layout innermost
+#if BGL_BlockLayout == BGL_LayoutXYZ
+#define BGL_LayoutName "XYZ"
+#define BGL_SizedBlockIndex(size, x, y, z) (((x) * (size) + (y)) * (size) + (z))
+#define BGL_ForEachBlock(x, y, z) BGL_ForEach3(x, y, z)
+#elif BGL_BlockLayout == BGL_LayoutXZY
+#define BGL_LayoutName "XZY"
+#define BGL_SizedBlockIndex(size, x, y, z) (((x) * (size) + (z)) * (size) + (y))
+#define BGL_ForEachBlock(x, y, z) BGL_ForEach3(x, z, y)
+#elif BGL_BlockLayout == BGL_LayoutYZX
+#define BGL_LayoutName "YZX"
+#define BGL_SizedBlockIndex(size, x, y, z) (((y) * (size) + (z)) * (size) + (x))
+#define BGL_ForEachBlock(x, y, z) BGL_ForEach3(y, z, x)
+#elif BGL_BlockLayout == BGL_LayoutMorton
+#define BGL_LayoutName "Morton"
+#define BGL_SizedBlockIndex(size, x, y, z) (spreadBits[x] << 2 | spreadBits[y] << 1 | spreadBits[z])
+#define BGL_ForEachBlock(x, y, z) BGL_ForEach3(x, y, z) // Consecutive z steps stay within 8 blocks
+#else
+#error "Unknown BGL_BlockLayout"
+#endif
+#define BGL_BlockIndex(x, y, z) BGL_SizedBlockIndex(BGL_ChunkSize, x, y, z)
+
+unsigned int blockIndex(unsigned int size, int x, int y, int z) {
+	return BGL_SizedBlockIndex(size, x, y, z);
+}
+
+// Position within a chunk of the given size of the block at index. The inverse of blockIndex()
+void blockPosition(unsigned int index, unsigned int size, int position[3]) {
+#if BGL_BlockLayout == BGL_LayoutMorton
+	memset(position, 0, 3 * sizeof(int));
+	for(int bit = 0; bit < 6; bit++) {
+		position[0] |= (index >> (bit * 3 + 2) & 1) << bit;
+		position[1] |= (index >> (bit * 3 + 1) & 1) << bit;
+		position[2] |= (index >> (bit * 3) & 1) << bit;
+	}
+#else
+	int a = index / (size * size), b = index / size % size, c = index % size;
+#if BGL_BlockLayout == BGL_LayoutXYZ
+	position[0] = a, position[1] = b, position[2] = c;
+#elif BGL_BlockLayout == BGL_LayoutXZY
+	position[0] = a, position[1] = c, position[2] = b;
+#else
+	position[0] = c, position[1] = a, position[2] = b;
+#endif
+#endif
+}
+
+unsigned int storageVolume(const struct BlockStorage* storage) {
+	return storage->size * storage->size * storage->size;
+}
+
+unsigned int paletteCapacity(unsigned int bits, unsigned int volume) {
+	unsigned int capacity = 1u << bits;
+	return capacity < volume ? capacity : volume;
+}
+
+void initBlockStorage(struct BlockStorage* storage, unsigned int size, unsigned short id) {
+	storage->palette = malloc(sizeof(unsigned short));
+	storage->palette[0] = id;
+	storage->paletteSize = 1;
+	storage->bits = 0;
+	storage->words = NULL;
+	storage->size = size;
+}
+
+void deinitBlockStorage(struct BlockStorage* storage) {
+	free(storage->palette);
+	free(storage->words);
+	storage->palette = NULL;
+	storage->words = NULL;
+}
+
+unsigned int getBlockIndexBits(const struct BlockStorage* storage, unsigned int index) {
+	unsigned int bit = index * storage->bits;
+	return (storage->words[bit >> 5] >> (bit & 31)) & ((1u << storage->bits) - 1);
+}
+
+void setBlockIndexBits(struct BlockStorage* storage, unsigned int index, unsigned int value) {
+	unsigned int bit = index * storage->bits;
+	uint32_t mask = ((1u << storage->bits) - 1) << (bit & 31);
+	storage->words[bit >> 5] = (storage->words[bit >> 5] & ~mask) | (value << (bit & 31));
+}
+
+unsigned short getStorageId(const struct BlockStorage* storage, unsigned int index) {
+	if(storage->bits == 0) return storage->palette[0];
+	return storage->palette[getBlockIndexBits(storage, index)];
+}
+
+// Repack the indices at a new width, which must have room for the palette
+void resizeBlockStorage(struct BlockStorage* storage, unsigned int bits) {
+	unsigned int volume = storageVolume(storage);
+	uint32_t* words = calloc(volume * bits / 32, sizeof(uint32_t));
+	struct BlockStorage resized = {storage->palette, storage->paletteSize, bits, words, storage->size};
+	if(storage->bits > 0) {
+		for(unsigned int i = 0; i < volume; i++) {
+			setBlockIndexBits(&resized, i, getBlockIndexBits(storage, i));
+		}
+	}
+	free(storage->words);
+	storage->words = words;
+	storage->bits = bits;
+	storage->palette = realloc(storage->palette, paletteCapacity(bits, volume) * sizeof(unsigned short));
+}
+
+/*
+ * Drop the palette ids no block uses anymore, not counting the block at skipIndex which is about to be overwritten,
+ * and repack at the narrowest width that still leaves room for one more id.
+ */
+void compactBlockStorage(struct BlockStorage* storage, unsigned int skipIndex) {
+	unsigned int volume = storageVolume(storage);
+	// Indexed by palette index, too large for the stack at 16 bits per block
+	unsigned short* remap = malloc(storage->paletteSize * sizeof(unsigned short));
+	bool* isUsed = calloc(storage->paletteSize, sizeof(bool));
+	for(unsigned int i = 0; i < volume; i++) {
+		if(i != skipIndex) isUsed[getBlockIndexBits(storage, i)] = true;
+	}
+	unsigned int count = 0;
+	for(unsigned int value = 0; value < storage->paletteSize; value++) {
+		if(!isUsed[value]) continue;
+		remap[value] = count;
+		storage->palette[count++] = storage->palette[value];
+	}
+	unsigned int skipped = getBlockIndexBits(storage, skipIndex);
+	if(!isUsed[skipped]) remap[skipped] = 0;
+
+	unsigned int bits = 0;
+	while(paletteCapacity(bits, volume) < count + 1) bits = bits == 0 ? 1 : bits * 2;
+	uint32_t* words = calloc(volume * bits / 32, sizeof(uint32_t));
+	struct BlockStorage packed = {storage->palette, count, bits, words, storage->size};
+	for(unsigned int i = 0; i < volume; i++) {
+		setBlockIndexBits(&packed, i, remap[getBlockIndexBits(storage, i)]);
+	}
+	free(remap);
+	free(isUsed);
+	free(storage->words);
+	storage->words = words;
+	storage->bits = bits;
+	storage->paletteSize = count;
+	storage->palette = realloc(storage->palette, paletteCapacity(bits, volume) * sizeof(unsigned short));
+}
+
+void setStorageId(struct BlockStorage* storage, unsigned int index, unsigned short id) {
+	unsigned int value = 0;
+	while(value < storage->paletteSize && storage->palette[value] != id) value++;
+	if(value == storage->paletteSize) {
+		if(value == paletteCapacity(storage->bits, storageVolume(storage))) {
+			// Ids that were overwritten may have left room, otherwise the indices get wider
+			if(storage->bits > 0) compactBlockStorage(storage, index);
+			if(storage->paletteSize == paletteCapacity(storage->bits, storageVolume(storage))) {
+				resizeBlockStorage(storage, storage->bits == 0 ? 1 : storage->bits * 2);
+			}
+			value = storage->paletteSize;
+		}
+		storage->palette[storage->paletteSize++] = id;
+	}
+	if(storage->bits > 0) setBlockIndexBits(storage, index, value);
+}
+
+// Replace the contents with the size^3 given blocks, using the narrowest width their palette allows
+void packBlockStorage(struct BlockStorage* storage, unsigned int size, const struct Block* blocks) {
+	deinitBlockStorage(storage);
+	initBlockStorage(storage, size, blocks[0].id);
+	unsigned int volume = size * size * size;
+	unsigned int last = 0; // Runs of equal ids are the common case
+	for(unsigned int i = 0; i < volume; i++) {
+		if(blocks[i].id == storage->palette[last]) continue;
+		last = 0;
+		while(last < storage->paletteSize && storage->palette[last] != blocks[i].id) last++;
+		if(last == storage->paletteSize) {
+			if(last == paletteCapacity(storage->bits, volume)) {
+				storage->bits = storage->bits == 0 ? 1 : storage->bits * 2;
+				storage->palette = realloc(storage->palette, paletteCapacity(storage->bits, volume) * sizeof(unsigned short));
+			}
+			storage->palette[storage->paletteSize++] = blocks[i].id;
+		}
+	}
+	if(storage->bits == 0) return;
+
+	storage->words = calloc(volume * storage->bits / 32, sizeof(uint32_t));
+	last = 0;
+	for(unsigned int i = 0; i < volume; i++) {
+		if(blocks[i].id != storage->palette[last]) {
+			last = 0;
+			while(storage->palette[last] != blocks[i].id) last++;
+		}
+		setBlockIndexBits(storage, i, last);
+	}
+}
+
+// Decode count consecutive blocks starting at index
+void unpackBlockRow(const struct BlockStorage* storage, unsigned int index, unsigned int count, unsigned short* ids) {
+	if(storage->bits == 0) {
+		for(unsigned int i = 0; i < count; i++) ids[i] = storage->palette[0];
+		return;
+	}
+	unsigned int bits = storage->bits;
+	uint32_t mask = (1u << bits) - 1;
+	unsigned int bit = index * bits;
+	for(unsigned int i = 0; i < count; i++, bit += bits) {
+		ids[i] = storage->palette[(storage->words[bit >> 5] >> (bit & 31)) & mask];
+	}
+}
+
+size_t getBlockStorageBytes(const struct BlockStorage* storage) {
+	unsigned int volume = storageVolume(storage);
+	return paletteCapacity(storage->bits, volume) * sizeof(unsigned short) + volume * storage->bits / 8;
+}
+
+/*
+ * Buffers of one chunk volume that the chunk kernels work in. At size 64 they add up to over 2 MB, too much for the
+ * stack of a worker thread, so each thread reserves a set once and reuses it like its MeshBuilder.
+ */
+struct ChunkScratch {
+	unsigned int size; // Chunk size the buffers fit, 0 before the first reserve
+	struct Block* blocks; // Generated terrain before it gets packed
+	unsigned short* ids; // Unpacked block ids in storage order
+	bool* visited; // Flood fill state of computeFaceConnections
+	uint32_t* stack; // Flood fill stack, block indices (x * size + y) * size + z
 };
 
+void initChunkScratch(struct ChunkScratch* scratch) {
+	scratch->size = 0;
+	scratch->blocks = NULL;
+	scratch->ids = NULL;
+	scratch->visited = NULL;
+	scratch->stack = NULL;
+}
+
+void deinitChunkScratch(struct ChunkScratch* scratch) {
+	free(scratch->blocks);
+	free(scratch->ids);
+	free(scratch->visited);
+	free(scratch->stack);
+	initChunkScratch(scratch);
+}
+
+// Make the buffers fit chunks of the given size. Only allocates when the size changes
+void reserveChunkScratch(struct ChunkScratch* scratch, unsigned int size) {
+	if(scratch->size == size) return;
+	deinitChunkScratch(scratch);
+	size_t volume = (size_t) size * size * size;
+	scratch->size = size;
+	scratch->blocks = malloc(volume * sizeof(struct Block));
+	scratch->ids = malloc(volume * sizeof(unsigned short));
+	scratch->visited = malloc(volume * sizeof(bool));
+	scratch->stack = malloc(volume * sizeof(uint32_t));
+}
+
+size_t getChunkScratchBytes(const struct ChunkScratch* scratch) {
+	size_t volume = (size_t) scratch->size * scratch->size * scratch->size;
+	return volume * (sizeof(struct Block) + sizeof(unsigned short) + sizeof(bool) + sizeof(uint32_t));
+}
+
 struct Chunk {
-	struct Block blocks[BGL_ChunkSize][BGL_ChunkSize][BGL_ChunkSize];
+	struct BlockStorage blocks;
 	struct Vec3i position;
 	bool isGenerated;
+	bool isQueued; // Waiting for a generator thread
 	bool isMeshUpToDate;
 	bool noMesh;
-	GLuint VAO, VBO, EBO;
+	unsigned char faceConnections[6]; // Bit j of entry i is set when faces i and j can see each other through air
+	unsigned int visibleFrame; // Last frame the visibility search reached this chunk
+	unsigned int meshRevision; // Bumped for every queued mesh so results of older jobs are dropped
+	unsigned int meshOffset; // First quad of the mesh in the vertex arena
+	unsigned int faceOffsets[7]; // Quads facing direction i are [faceOffsets[i], faceOffsets[i + 1]) after meshOffset
 	GLuint indicesSize;
+	struct Chunk* nextFree; // Link in the pool while unused
+	bool isCached; // Outside the load volume, kept until it is entered again or evicted
+	size_t cacheBytes; // Currently charged to the cache, see chargeCachedChunk()
+	struct Chunk* cachePrev; // Newer neighbour in the cache
+	struct Chunk* cacheNext; // Older neighbour in the cache
+};
+
+unsigned short getBlockId(const struct Chunk* chunk, int x, int y, int z) {
+	return getStorageId(&chunk->blocks, blockIndex(chunk->blocks.size, x, y, z));
+}
+
+void setBlockId(struct Chunk* chunk, int x, int y, int z, unsigned short id) {
+	setStorageId(&chunk->blocks, blockIndex(chunk->blocks.size, x, y, z), id);
+}
+
+enum MeshMode {
+	BGL_MeshNaive, // One quad per visible block face
+	BGL_MeshGreedy, // Coplanar faces with the same texture merged into rectangles
+	BGL_MeshBinary, // Same faces as naive, found with bitwise operations on occupancy columns
+	BGL_MeshModeCount
+};
+
+static const char* meshModeNames[BGL_MeshModeCount] = {"naive", "greedy", "binary"};
+
+struct VisibilityStep {
+	struct Vec3i position;
+	int entryFace; // Face the search came in through, -1 for the camera chunk
+	unsigned char directions; // Directions taken since the camera chunk
+};
+
+/*
+ * All chunk meshes live in one vertex buffer. Chunks get a range of quads from a first-fit allocator, and the buffer
+ * doubles when a mesh doesn't fit. A single VAO reads it together with the shared quad index buffer.
+ */
+#define BGL_VertexArenaInitialQuads (1 << 16)
+#define BGL_QuadBytes (4 * 2 * sizeof(GLuint)) // 4 corners of 2 packed integers each
+
+struct ArenaRange {
+	unsigned int offset, size; // In quads
+};
+
+struct VertexArena {
+	GLuint VAO, VBO;
+	unsigned int capacity; // In quads
+	unsigned int usedQuads;
+	struct ArenaRange* freeRanges; // Sorted by offset, never touching each other
+	unsigned int freeCount, freeCapacity;
+};
+
+/*
+ * Mesh data reaches the vertex arena through a staging ring and a GPU side copy, so uploads never reallocate or wait
+ * on storage the GPU may still be drawing from. With GL_ARB_buffer_storage the ring is persistently mapped and split
+ * into sections, each guarded by a fence placed when the ring moves past it. Otherwise writes go through unsynchronized
+ * mappings and the ring storage is orphaned each time it wraps.
+ */
+#define BGL_UploadRingSize		(4 << 20) // Bytes, room for several typical meshes, larger ones go over in pieces
+#define BGL_UploadRingSections	3 // Frames that can be in flight
+
+struct UploadRing {
+	GLuint buffer;
+	GLubyte* mapped; // Persistent mapping, NULL when falling back to orphaning
+	GLsync fences[BGL_UploadRingSections];
+	unsigned int section;
+	size_t head; // Next write position in bytes
+	// Statistics
+	unsigned int frameUploads;
+	size_t frameBytes;
+	double frameStall, totalStall; // Seconds spent waiting on fences or orphaning
+};
+
+// Layout read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+/*
+ * Chunk draws gathered during a frame and submitted with one call. A chunk adds up to 3 draws, one for each
+ * contiguous run of face directions that can point at the camera.
+ */
+struct DrawList {
+	unsigned int count, capacity;
+	GLsizei* counts;
+	GLint* baseVertices;
+	const GLvoid** indices; // Offsets into the quad index buffer, all 0
+	struct DrawElementsIndirectCommand* commands;
+	GLuint indirectBuffer; // 0 without GL_ARB_multi_draw_indirect
+	unsigned long drawnQuads, directionCulledQuads;
+};
+
+/*
+ * Adjusts the view radius every few seconds to keep the 95th percentile frame time under a target. The radius only
+ * grows after several windows well under the target and shrinks as soon as one goes over, so it settles instead of
+ * oscillating. Chunks beyond a shrunk view radius stay loaded until the chunk memory passes the budget.
+ */
+#define BGL_TargetFrameTime		0.020 // Seconds, above vsync at 60 Hz
+#define BGL_ViewWindowTime		3.0 // Seconds of frames per decision
+#define BGL_ViewWindowFrames	1024 // Decide early when a window fills up
+#define BGL_ViewGrowMargin		0.75 // Grow only while p95 is under this fraction of the target
+#define BGL_ViewGrowWindows		2 // Consecutive windows under the margin before growing
+#define BGL_ChunkMemoryBudget	((size_t) 256 << 20) // Bytes of block data, meshes and chunk storage
+
+struct ViewDistanceController {
+	bool isEnabled;
+	double targetFrameTime;
+	size_t memoryBudget;
+	double frameTimes[BGL_ViewWindowFrames];
+	unsigned int frameCount;
+	double windowTime;
+	unsigned int goodWindows;
+	// Statistics of the last window
+	double medianFrameTime, p95FrameTime;
+	unsigned int adjustments;
+};
+
+/*
+ * Resident chunks are found through an open-addressing hash map keyed by chunk position. Keys sit next to the chunk
+ * pointers so a probe stays within one or two cache lines, and removal shifts later entries back instead of leaving
+ * tombstones. The chunks themselves come from a pool of fixed pages so their addresses never change.
+ */
+#define BGL_ChunkMapInitialCapacity	1024 // Power of two
+#define BGL_ChunkPoolPageSize		256 // Chunks per pool allocation
+
+struct ChunkMapEntry {
+	struct Vec3i position;
+	struct Chunk* chunk; // NULL for an empty entry
+};
+
+struct ChunkMap {
+	struct ChunkMapEntry* entries;
+	unsigned int capacity; // Power of two, kept at least twice the count
+	unsigned int count;
+};
+
+struct ChunkPool {
+	struct Chunk** pages;
+	unsigned int pageCount;
+	struct Chunk* freeChunks;
+};
+
+#define BGL_ChunkCacheBudget	((size_t) 64 << 20) // Bytes of block data and meshes of cached chunks
+#define BGL_ChunkCacheMeshes	true // Cached chunks keep their meshes, otherwise they are meshed again on return
+
+/*
+ * Generated chunks that leave the load volume stay in the chunk map, linked into a list from the most to the least
+ * recently left. Coming back within the budget costs a lookup instead of a load and remesh.
+ */
+struct ChunkCache {
+	struct Chunk* newest;
+	struct Chunk* oldest; // Evicted first
+	unsigned int count;
+	size_t bytes, budget;
+	bool keepsMeshes; // Otherwise only the blocks are kept
+	unsigned long hits, evictions;
 };
 
+// Cached chunks are charged again when their mesh or blocks change afterwards
+void chargeCachedChunk(struct ChunkCache* cache, struct Chunk* chunk) {
+	cache->bytes -= chunk->cacheBytes;
+	chunk->cacheBytes = getBlockStorageBytes(&chunk->blocks) + (size_t) chunk->indicesSize / 6 * BGL_QuadBytes;
+	cache->bytes += chunk->cacheBytes;
+}
+
 struct World {
-	struct Chunk chunks[BGL_LoadSize][BGL_LoadSize][BGL_LoadSize];
+	unsigned int chunkSize; // Blocks along each axis of a chunk, fixed at creation
+	const struct ChunkKernels* kernels; // The specialized chunk code for chunkSize
+	struct ChunkScratch scratch; // For the kernels run on the main thread
+	struct ChunkMap chunks;
+	struct ChunkPool chunkPool;
+	struct ChunkCache cache;
+	struct Chunk* lastChunk; // Result of the last findChunk, checked before probing
+	struct Vec3i loadCenter; // Chunk the load volume was last trimmed around
+	struct Vec3i loadRadius; // In chunks, x and z share the horizontal radius
+	struct Vec3i requestedRadius; // Applied by updateLoadVolume
+	struct Vec3i viewRadius; // Drawn chunks, at most loadRadius - 1
+	struct ViewDistanceController viewController;
 	vec3 skyColor;
 	vec3 lightColor;
 	vec3 lightPos;
+	enum MeshMode meshMode;
+	unsigned int meshRevision; // Last revision handed to a chunk, unique across chunks
+	unsigned long meshQuads; // Quads currently uploaded for all chunks
+	unsigned long cachedQuads; // Part of meshQuads belonging to cached chunks
+	size_t chunkBlockBytes; // Block storage of the loaded chunks outside the cache
+	GLuint quadIndexBuffer;
+	struct VertexArena arena;
+	struct UploadRing uploads;
+	struct DrawList drawList;
+	unsigned int visibilityFrame;
+	struct VisibilityStep* visibilityQueue; // One entry per chunk map entry
+	struct EditLog* edits; // Replayed over generated chunks and extended by setWorldBlock, may be NULL
 };
 
+unsigned int hashChunkPos(const struct Vec3i p) {
+	uint32_t h = (uint32_t) p.x * 0x8da6b343u + (uint32_t) p.y * 0xd8163841u + (uint32_t) p.z * 0xcb1ab31fu;
+	h ^= h >> 15;
+	h *= 0x2c1b3c6du;
+	return h ^ (h >> 12);
+}
+
+// Entry holding position, or the empty entry where it would go
+struct ChunkMapEntry* probeChunkMap(const struct ChunkMap* map, const struct Vec3i position) {
+	unsigned int mask = map->capacity - 1;
+	unsigned int i = hashChunkPos(position) & mask;
+	while(map->entries[i].chunk && memcmp(&map->entries[i].position, &position, sizeof(struct Vec3i)) != 0) {
+		i = (i + 1) & mask;
+	}
+	return &map->entries[i];
+}
+
+// The loaded chunk at chunkPos, or NULL
+struct Chunk* findChunk(struct World* world, const struct Vec3i chunkPos) {
+	struct Chunk* last = world->lastChunk;
+	if(last && memcmp(&last->position, &chunkPos, sizeof(struct Vec3i)) == 0) return last;
+	struct Chunk* chunk = probeChunkMap(&world->chunks, chunkPos)->chunk;
+	if(chunk) world->lastChunk = chunk;
+	return chunk;
+}
+
 struct Camera {
 	vec3 position;
 	vec3 rotation;
 	double mouseX, mouseY;
+	bool isBreaking, isPlacing; // Mouse buttons held last frame
 };
 
 inline double toDegree(double radians) {
@@ -190,6 +722,40 @@ void getCameraMatrix(struct Camera* camera, mat4x4* mat) {
 	mat4x4_translate_in_place(*mat, -camera->position[0], -camera->position[1], -camera->position[2]);
 }
 
+/*
+ * The view frustum as six planes (a, b, c, d). A point p is inside when a * p.x + b * p.y + c * p.z + d >= 0 for all
+ * of them. The planes are sums and differences of the rows of the combined projection and view matrix.
+ */
+struct Frustum {
+	vec4 planes[6];
+};
+
+void extractFrustum(struct Frustum* frustum, mat4x4 viewProjection) {
+	for(int i = 0; i < 3; i++) {
+		for(int j = 0; j < 4; j++) {
+			// linmath matrices are column major, m[column][row]
+			frustum->planes[i * 2][j] = viewProjection[j][3] + viewProjection[j][i];
+			frustum->planes[i * 2 + 1][j] = viewProjection[j][3] - viewProjection[j][i];
+		}
+	}
+}
+
+// Conservative: may keep chunks near the frustum corners that are outside, never drops a visible one
+bool isChunkInFrustum(const struct Frustum* frustum, const struct Vec3i chunkPos, int chunkSize) {
+	// Blocks are centered on integer positions
+	float lo[3] = {chunkPos.x * chunkSize - 0.5f, chunkPos.y * chunkSize - 0.5f, chunkPos.z * chunkSize - 0.5f};
+	for(int i = 0; i < 6; i++) {
+		const float* plane = frustum->planes[i];
+		// The box corner furthest along the plane normal
+		float distance = plane[3];
+		for(int axis = 0; axis < 3; axis++) {
+			distance += plane[axis] * (plane[axis] > 0 ? lo[axis] + chunkSize : lo[axis]);
+		}
+		if(distance < 0) return false;
+	}
+	return true;
+}
+
 void handleCameraInput(struct Camera* cam, GLFWwindow* window, const double DT) {
 	if(glfwGetInputMode(window, GLFW_CURSOR) != GLFW_CURSOR_DISABLED) return;
 
@@ -323,40 +889,175 @@ void buildShader(GLuint* program, const char* vertSource, const char* fragSource
 	glDeleteShader(fragmentShader);
 }
 
-void initChunk(struct Chunk* chunk) {
-	//VAO
-	GLuint VAO, VBO, EBO;
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
+/*
+ * Every mesh is a list of quads with 4 vertices each, so the indices are the same for all of them: 2, 1, 0, 2, 3, 1
+ * offset by 4 for each quad. One buffer built for the largest possible mesh serves every chunk.
+ */
+GLuint initQuadIndexBuffer(unsigned int maxQuads) {
+	GLuint* indices = malloc(maxQuads * 6 * sizeof(GLuint)); // 6 indices to make a square face
+	static const GLuint quadIndices[6] = {2, 1, 0, 2, 3, 1};
+	for(unsigned int quad = 0; quad < maxQuads; quad++) {
+		for(int i = 0; i < 6; i++) {
+			indices[quad * 6 + i] = quad * 4 + quadIndices[i];
+		}
+	}
+
+	// Filled through GL_ARRAY_BUFFER since element array bindings belong to a VAO
+	GLuint EBO;
 	glGenBuffers(1, &EBO);
+	glBindBuffer(GL_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ARRAY_BUFFER, maxQuads * 6 * sizeof(GLuint), indices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	free(indices);
+	return EBO;
+}
+
+// Point the VAO at the current arena buffer
+void bindVertexArena(struct VertexArena* arena) {
+	glBindVertexArray(arena->VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, arena->VBO);
+	//Packed vertex attribute
+	glVertexAttribIPointer(0, 2, GL_UNSIGNED_INT, 2 * sizeof(GLuint), (GLvoid*)0);
+	glEnableVertexAttribArray(0);
+	glBindVertexArray(0); //Unbind VAO
+}
 
-	glBindVertexArray(VAO);
+void initVertexArena(struct VertexArena* arena, GLuint quadIndexBuffer) {
+	arena->capacity = BGL_VertexArenaInitialQuads;
+	arena->usedQuads = 0;
+	arena->freeCapacity = 64;
+	arena->freeRanges = malloc(arena->freeCapacity * sizeof(struct ArenaRange));
+	arena->freeRanges[0] = (struct ArenaRange){0, arena->capacity};
+	arena->freeCount = 1;
+
+	glGenVertexArrays(1, &arena->VAO);
+	glGenBuffers(1, &arena->VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, arena->VBO);
+	glBufferData(GL_ARRAY_BUFFER, arena->capacity * BGL_QuadBytes, NULL, GL_DYNAMIC_DRAW);
+
+	glBindVertexArray(arena->VAO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadIndexBuffer);
+	glBindVertexArray(0);
+	bindVertexArena(arena);
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+void deinitVertexArena(struct VertexArena* arena) {
+	free(arena->freeRanges);
+	glDeleteVertexArrays(1, &arena->VAO);
+	glDeleteBuffers(1, &arena->VBO);
+}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+// Add a range to the free list, merging it with the free ranges it touches
+void insertFreeRange(struct VertexArena* arena, unsigned int offset, unsigned int size) {
+	unsigned int i = 0;
+	while(i < arena->freeCount && arena->freeRanges[i].offset < offset) i++;
+
+	bool mergePrevious = i > 0 && arena->freeRanges[i - 1].offset + arena->freeRanges[i - 1].size == offset;
+	bool mergeNext = i < arena->freeCount && offset + size == arena->freeRanges[i].offset;
+	if(mergePrevious && mergeNext) {
+		arena->freeRanges[i - 1].size += size + arena->freeRanges[i].size;
+		memmove(&arena->freeRanges[i], &arena->freeRanges[i + 1], (arena->freeCount - i - 1) * sizeof(struct ArenaRange));
+		arena->freeCount--;
+	} else if(mergePrevious) {
+		arena->freeRanges[i - 1].size += size;
+	} else if(mergeNext) {
+		arena->freeRanges[i].offset = offset;
+		arena->freeRanges[i].size += size;
+	} else {
+		if(arena->freeCount == arena->freeCapacity) {
+			arena->freeCapacity *= 2;
+			arena->freeRanges = realloc(arena->freeRanges, arena->freeCapacity * sizeof(struct ArenaRange));
+		}
+		memmove(&arena->freeRanges[i + 1], &arena->freeRanges[i], (arena->freeCount - i) * sizeof(struct ArenaRange));
+		arena->freeRanges[i] = (struct ArenaRange){offset, size};
+		arena->freeCount++;
+	}
+}
 
-	//Position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(0);
-	//TexCoord attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
-	glEnableVertexAttribArray(1);
-	//Normal attribute
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
-	glEnableVertexAttribArray(2);
+void freeArenaRange(struct VertexArena* arena, unsigned int offset, unsigned int size) {
+	insertFreeRange(arena, offset, size);
+	arena->usedQuads -= size;
+}
 
-	glBindVertexArray(0); //Unbind VAO
+// Move the arena into a buffer at least twice as large, keeping every allocated range where it was
+void growVertexArena(struct VertexArena* arena, unsigned int minCapacity) {
+	unsigned int capacity = arena->capacity * 2;
+	while(capacity < minCapacity) capacity *= 2;
 
-	chunk->VAO = VAO;
-	chunk->VBO = VBO;
-	chunk->EBO = EBO;
+	GLuint VBO;
+	glGenBuffers(1, &VBO);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+	glBufferData(GL_COPY_WRITE_BUFFER, capacity * BGL_QuadBytes, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, arena->VBO);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, arena->capacity * BGL_QuadBytes);
+	glDeleteBuffers(1, &arena->VBO);
+	arena->VBO = VBO;
+
+	unsigned int oldCapacity = arena->capacity;
+	arena->capacity = capacity;
+	insertFreeRange(arena, oldCapacity, capacity - oldCapacity);
+	bindVertexArena(arena);
+	printf("Vertex arena grown to %u quads\n", capacity);
+}
+
+// First fit. Returns the offset of the range in quads
+unsigned int allocArenaRange(struct VertexArena* arena, unsigned int size) {
+	for(;;) {
+		for(unsigned int i = 0; i < arena->freeCount; i++) {
+			struct ArenaRange* range = &arena->freeRanges[i];
+			if(range->size < size) continue;
+
+			unsigned int offset = range->offset;
+			range->offset += size;
+			range->size -= size;
+			if(range->size == 0) {
+				memmove(range, range + 1, (arena->freeCount - i - 1) * sizeof(struct ArenaRange));
+				arena->freeCount--;
+			}
+			arena->usedQuads += size;
+			return offset;
+		}
+		growVertexArena(arena, arena->usedQuads + size);
+	}
+}
+
+void resizeDrawList(struct DrawList* list, unsigned int chunkCount) {
+	list->capacity = chunkCount * 3;
+	list->counts = realloc(list->counts, list->capacity * sizeof(GLsizei));
+	list->baseVertices = realloc(list->baseVertices, list->capacity * sizeof(GLint));
+	list->indices = realloc(list->indices, list->capacity * sizeof(const GLvoid*));
+	list->commands = realloc(list->commands, list->capacity * sizeof(struct DrawElementsIndirectCommand));
+	for(unsigned int i = 0; i < list->capacity; i++) {
+		list->indices[i] = 0;
+	}
+}
+
+void initDrawList(struct DrawList* list, unsigned int chunkCount) {
+	list->count = 0;
+	list->drawnQuads = 0;
+	list->directionCulledQuads = 0;
+	list->counts = NULL;
+	list->baseVertices = NULL;
+	list->indices = NULL;
+	list->commands = NULL;
+	resizeDrawList(list, chunkCount);
+	list->indirectBuffer = 0;
+	if(GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_draw_indirect) {
+		glGenBuffers(1, &list->indirectBuffer);
+	}
+	printf("Chunk draws use %s\n", list->indirectBuffer ? "glMultiDrawElementsIndirect" : "glMultiDrawElementsBaseVertex");
+}
+
+void deinitDrawList(struct DrawList* list) {
+	free(list->counts);
+	free(list->baseVertices);
+	free(list->indices);
+	free(list->commands);
+	if(list->indirectBuffer) glDeleteBuffers(1, &list->indirectBuffer);
 }
 
 void deinitChunk(struct Chunk* chunk) {
-	glDeleteVertexArrays(1, &chunk->VAO);
-	glDeleteBuffers(1, &chunk->VBO);
-	glDeleteBuffers(1, &chunk->EBO);
+	deinitBlockStorage(&chunk->blocks);
 }
 
 static const GLfloat cube_vertices[] = {
@@ -424,237 +1125,2422 @@ void defineBlockTexture(GLuint array[BGL_BlockCount][6], GLuint id, GLuint right
 
 static GLuint block_textureIds[BGL_BlockCount][6];
 
-void checkBlock(struct World* world, unsigned char* id, int gx, int gy, int gz) {
+void checkBlock(struct World* world, unsigned short* id, int gx, int gy, int gz) {
 	vec3 globalPos = {gx, gy, gz};
-	struct Vec3i chunkPos = toChunkPos(globalPos);
-	struct Vec3i memPos = toMemoryPos(chunkPos);
-	int x1 = gx - chunkPos.x * BGL_ChunkSize;
-	int y1 = gy - chunkPos.y * BGL_ChunkSize;
-	int z1 = gz - chunkPos.z * BGL_ChunkSize;
-	*id = world->chunks[memPos.x][memPos.y][memPos.z].blocks[x1][y1][z1].id;
-}
-
-void generateMesh(struct World* world, struct Chunk* chunk) {
-	//printf("Generating mesh\n");
-	// Create buffers with the maximum necessary size
-	GLfloat vertices[BGL_MaxFaces * 4 * 9]; // 4 corners and 9 attributes for each vertex. xyz texX texY texId normX normY normZ
-	GLuint indices[BGL_MaxFaces * 6]; // 6 indices to make a square face
-	unsigned int verticesSize = 0, indicesSize = 0;
-	unsigned int indicesCount = 0;
-
-	for(int x = 0; x < BGL_ChunkSize; x++) {
-		for (int y = 0; y < BGL_ChunkSize; y++) {
-			for (int z = 0; z < BGL_ChunkSize; z++) {
-				float gx = (int)BGL_ChunkSize * chunk->position.x + x;
-				float gy = (int)BGL_ChunkSize * chunk->position.y + y;
-				float gz = (int)BGL_ChunkSize * chunk->position.z + z;
-				const unsigned char id = chunk->blocks[x][y][z].id;
-				if(id > 0) {
-					for(int i = 0; i < 6; i++) {
-						int normalIndex = i * 3;
-						unsigned char neighbour = 0;
-						struct Vec3i checkPos = { x + cube_normals[0 + normalIndex], y + cube_normals[1 + normalIndex], z + cube_normals[2 + normalIndex]};
-						if(checkPos.x >= 0 && checkPos.x < BGL_ChunkSize && checkPos.y >= 0 && checkPos.y < BGL_ChunkSize && checkPos.z >= 0 && checkPos.z < BGL_ChunkSize) {
-							neighbour = chunk->blocks[checkPos.x][checkPos.y][checkPos.z].id;
-						}
-						else {
-							checkBlock(world, &neighbour, gx + cube_normals[0 + normalIndex], gy + cube_normals[1 + normalIndex], gz + cube_normals[2 + normalIndex]);
-						}
-
-						if (neighbour == 0) {
-							for (int j = 0; j < 4; j++) {
-								int posIndex = j * 3 + i * 12;
-								vertices[verticesSize] = cube_vertices[0 + posIndex] + gx;
-								++verticesSize;
-								vertices[verticesSize] = cube_vertices[1 + posIndex] + gy;
-								++verticesSize;
-								vertices[verticesSize] = cube_vertices[2 + posIndex] + gz;
-								++verticesSize;
-
-								int textureIndex = j * 2;
-								vertices[verticesSize] = cube_texture[0 + textureIndex];
-								++verticesSize;
-								vertices[verticesSize] = cube_texture[1 + textureIndex];
-								++verticesSize;
-								vertices[verticesSize] = block_textureIds[id][i];
-								++verticesSize;
-
-								vertices[verticesSize] = cube_normals[0 + normalIndex];
-								++verticesSize;
-								vertices[verticesSize] = cube_normals[1 + normalIndex];
-								++verticesSize;
-								vertices[verticesSize] = cube_normals[2 + normalIndex];
-								++verticesSize;
-							}
-
-							indices[indicesSize] = (2 + indicesCount);
-							++indicesSize;
-							indices[indicesSize] = (1 + indicesCount);
-							++indicesSize;
-							indices[indicesSize] = (0 + indicesCount);
-							++indicesSize;
-							indices[indicesSize] = (2 + indicesCount);
-							++indicesSize;
-							indices[indicesSize] = (3 + indicesCount);
-							++indicesSize;
-							indices[indicesSize] = (1 + indicesCount);
-							++indicesSize;
-							indicesCount += 4;
-						}
-					}
-				}
-			}
-		}
+	struct Vec3i chunkPos = toChunkPos(globalPos, world->chunkSize);
+	int x1 = gx - chunkPos.x * (int)world->chunkSize;
+	int y1 = gy - chunkPos.y * (int)world->chunkSize;
+	int z1 = gz - chunkPos.z * (int)world->chunkSize;
+	struct Chunk* chunk = findChunk(world, chunkPos);
+	*id = chunk ? getBlockId(chunk, x1, y1, z1) : 0;
+}
+
+// Texture axes of each face, matching the corner order of cube_vertices and cube_texture, and textureAxes in the shader
+static const int face_uAxis[6] = {2, 2, 0, 0, 0, 0};
+static const int face_vAxis[6] = {1, 1, 2, 2, 1, 1};
+
+/*
+ * Growable scratch buffers a mesher writes into. Each meshing thread keeps one and reuses it for every mesh, so the
+ * buffers settle at the size of the largest mesh seen instead of the worst case of BGL_MaxFaces().
+ */
+#define BGL_MeshBuilderInitialQuads 1024
+
+struct MeshBuilder {
+	GLuint* vertices; // 2 per vertex, indexed through the shared quad index buffer
+	GLuint chunkBits; // Packed chunk position, added to the texture layer of every vertex
+	unsigned int verticesSize;
+	unsigned int quadCount;
+	unsigned int quadCapacity; // Quads that fit in vertices
+};
+
+GLuint packChunkPosition(const struct Vec3i position) {
+	return ((GLuint)position.x & 255u) << 8 | ((GLuint)position.y & 255u) << 16 | ((GLuint)position.z & 255u) << 24;
+}
+
+void initMeshBuilder(struct MeshBuilder* mesh) {
+	mesh->quadCapacity = BGL_MeshBuilderInitialQuads;
+	mesh->vertices = malloc(mesh->quadCapacity * 4 * 2 * sizeof(GLuint)); // 4 corners of 2 packed integers each
+	mesh->chunkBits = 0;
+	mesh->verticesSize = 0;
+	mesh->quadCount = 0;
+}
+
+void deinitMeshBuilder(struct MeshBuilder* mesh) {
+	free(mesh->vertices);
+}
+
+// Start a new mesh, keeping the buffers
+void resetMeshBuilder(struct MeshBuilder* mesh) {
+	mesh->verticesSize = 0;
+	mesh->quadCount = 0;
+}
+
+size_t meshBuilderBytes(const struct MeshBuilder* mesh) {
+	return (size_t)mesh->quadCapacity * 4 * 2 * sizeof(GLuint);
+}
+
+void growMeshBuilder(struct MeshBuilder* mesh) {
+	assert(mesh->quadCapacity < BGL_MaxFaces(BGL_MaxChunkSize));
+	mesh->quadCapacity *= 2;
+	if(mesh->quadCapacity > BGL_MaxFaces(BGL_MaxChunkSize)) mesh->quadCapacity = BGL_MaxFaces(BGL_MaxChunkSize);
+	mesh->vertices = realloc(mesh->vertices, mesh->quadCapacity * 4 * 2 * sizeof(GLuint));
+}
+
+/*
+ * Add a quad facing direction i that covers all block faces from lo to hi (chunk local block positions, inclusive).
+ * Each vertex is packed into two integers:
+ *  - bits 0-20: corner position relative to the chunk origin in half-block shifted units, 7 bits per axis (0 - 64)
+ *  - bits 21-23: face direction, the index into cube_normals
+ *  - second integer: texture layer in bits 0-7, then the low 8 bits of the chunk position per axis (see chunkBits)
+ * The vertex shader rebuilds the world position from the chunk bits and the cameraChunk uniform, and the texture
+ * coordinates from the corner position. Merged quads repeat the texture.
+ */
+void addQuad(struct MeshBuilder* mesh, const int lo[3], const int hi[3], GLuint textureId, int i) {
+	// Position bits taken from the high side of the quad for each corner, following the signs in cube_vertices
+	static const GLuint cornerHighBits[6][4] = {
+			{0x1fffff, 0x003fff, 0x1fc07f, 0x00007f},
+			{0x003f80, 0x1fff80, 0x000000, 0x1fc000},
+			{0x003f80, 0x003fff, 0x1fff80, 0x1fffff},
+			{0x00007f, 0x000000, 0x1fc07f, 0x1fc000},
+			{0x1fff80, 0x1fffff, 0x1fc000, 0x1fc07f},
+			{0x003fff, 0x003f80, 0x00007f, 0x000000},
+	};
+
+	if(mesh->quadCount == mesh->quadCapacity) growMeshBuilder(mesh);
+
+	GLuint* vertices = mesh->vertices;
+	GLuint low = lo[0] | lo[1] << 7 | lo[2] << 14;
+	GLuint high = (hi[0] + 1) | (hi[1] + 1) << 7 | (hi[2] + 1) << 14;
+	GLuint shared = (GLuint)i << 21;
+	for (int j = 0; j < 4; j++) {
+		GLuint highBits = cornerHighBits[i][j];
+		vertices[mesh->verticesSize] = (high & highBits) | (low & ~highBits) | shared;
+		++mesh->verticesSize;
+		vertices[mesh->verticesSize] = textureId | mesh->chunkBits;
+		++mesh->verticesSize;
 	}
+	++mesh->quadCount;
+}
 
-	// Ensure that no overflow has occurred.
-	assert(verticesSize <= sizeof(vertices) / sizeof(vertices[0]));
-	assert(indicesSize <= sizeof(indices) / sizeof(indices[0]));
+void addFace(struct MeshBuilder* mesh, int x, int y, int z, unsigned short id, int i) {
+	int pos[3] = {x, y, z};
+	addQuad(mesh, pos, pos, block_textureIds[id][i], i);
+}
 
-	if(verticesSize > 1) {
-		// Ensure that the expected size ratio is met
-		assert((verticesSize / indicesSize == 6) && (verticesSize % indicesSize == 0));
-		chunk->noMesh = false;
+// Copy the quads into sorted grouped by face direction. Quads of direction i end up in [faceOffsets[i], faceOffsets[i + 1])
+void sortQuadsByFace(const struct MeshBuilder* mesh, GLuint* sorted, unsigned int faceOffsets[7]) {
+	unsigned int counts[6] = {0};
+	for(unsigned int quad = 0; quad < mesh->quadCount; quad++) {
+		counts[(mesh->vertices[quad * 8] >> 21) & 7]++;
+	}
+	unsigned int next[6];
+	faceOffsets[0] = 0;
+	for(int i = 0; i < 6; i++) {
+		next[i] = faceOffsets[i];
+		faceOffsets[i + 1] = faceOffsets[i] + counts[i];
 	}
-	else {
-		assert(verticesSize == 0 && indicesSize == 0 && indicesCount == 0);
-		chunk->noMesh = true;
+	for(unsigned int quad = 0; quad < mesh->quadCount; quad++) {
+		const GLuint* source = &mesh->vertices[quad * 8];
+		memcpy(&sorted[next[(source[0] >> 21) & 7]++ * 8], source, 8 * sizeof(GLuint));
 	}
-	chunk->indicesSize = indicesSize;
+}
+
+/*
+ * Everything a mesher reads: the chunk's blocks plus a one block halo copied from the six neighbours, indexed
+ * [x + 1][y + 1][z + 1]. Being a snapshot, it doesn't touch the world once built. The halo edges and corners are
+ * never read and left as air.
+ */
+struct MeshInput {
+	unsigned int size; // Of the chunk
+	bool isUniform;
+	unsigned short uniformId;
+	unsigned short ids[]; // (size + 2)^3
+};
+
+struct MeshInput* allocMeshInput(unsigned int size) {
+	unsigned int paddedSize = size + 2;
+	struct MeshInput* input = calloc(1, sizeof(struct MeshInput) + paddedSize * paddedSize * paddedSize * sizeof(unsigned short));
+	input->size = size;
+	return input;
+}
+
+struct Heightmap {
+	float heights[BGL_MaxChunkSize * BGL_MaxChunkSize]; // [x * chunk size + z]
+	float minHeight, maxHeight; // Bounds of heights, used to spot uniform chunks without generating them
+};
+
+/*
+ * Functions specialized for one chunk size, see chunksize.h. Everything that loops over the blocks of a chunk goes
+ * through here, the rest of the code handles any of the sizes at runtime.
+ */
+struct ChunkKernels {
+	unsigned int size;
+	void (*generateHeightmap)(struct Heightmap* map, int chunkX, int chunkZ);
+	void (*generateChunkBlocks)(const struct Heightmap* map, const struct Vec3i position, struct BlockStorage* blocks, struct ChunkScratch* scratch);
+	void (*copyMeshInput)(struct World* world, const struct Chunk* chunk, struct MeshInput* input, struct ChunkScratch* scratch);
+	void (*buildMesh[BGL_MeshModeCount])(const struct MeshInput* input, struct MeshBuilder* mesh);
+	void (*computeFaceConnections)(const struct MeshInput* input, unsigned char connections[6], struct ChunkScratch* scratch);
+	void (*benchmark)();
+};
 
-	glBindVertexArray(chunk->VAO);
+#define BGL_BenchmarkBlocks		(2048 * 4096) // 16 MB of unpacked blocks
+#define BGL_BenchmarkLookups	(1 << 22)
 
-	glBindBuffer(GL_ARRAY_BUFFER, chunk->VBO);
-	glBufferData(GL_ARRAY_BUFFER, verticesSize * sizeof(GLfloat), vertices, GL_STATIC_DRAW);
+double getBenchmarkTime() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk->EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesSize * sizeof(GLuint), indices, GL_STATIC_DRAW);
+#define BGL_ChunkSize 16
+#include "chunksize.h"
+#undef BGL_ChunkSize
+#define BGL_ChunkSize 32
+#include "chunksize.h"
+#undef BGL_ChunkSize
+#define BGL_ChunkSize 64
+#include "chunksize.h"
+#undef BGL_ChunkSize
+
+static const struct ChunkKernels* chunkKernels[] = {&chunkKernels16, &chunkKernels32, &chunkKernels64};
+
+// The specialized code for chunks of the given size, or NULL if there is none
+const struct ChunkKernels* getChunkKernels(unsigned int size) {
+	for(unsigned int i = 0; i < sizeof(chunkKernels) / sizeof(chunkKernels[0]); i++) {
+		if(chunkKernels[i]->size == size) return chunkKernels[i];
+	}
+	return NULL;
 }
 
-void initWorld(struct World* world) {
-	world->skyColor[0] = 0.1f;
-	world->skyColor[1] = 0.6f;
-	world->skyColor[2] = 0.9f;
+/*
+ * Times the chunk work whose speed depends on the block layout and chunk size: generating and packing terrain,
+ * unpacking it into mesh input, walking every block against its six neighbours, reading the neighbourhoods of random
+ * blocks and remeshing. The chunks together are larger than the caches, so random reads mostly count cache misses.
+ * Runs for every chunk size, build once per BGL_BlockLayout to compare layouts.
+ */
+void benchmarkBlockLayout() {
+	for(unsigned int i = 0; i < sizeof(chunkKernels) / sizeof(chunkKernels[0]); i++) {
+		chunkKernels[i]->benchmark();
+	}
+}
 
-	world->lightColor[0] = 1.f;
-	world->lightColor[1] = 1.f;
-	world->lightColor[2] = 1.f;
+void initUploadRing(struct UploadRing* ring) {
+	glGenBuffers(1, &ring->buffer);
+	glBindBuffer(GL_COPY_READ_BUFFER, ring->buffer);
+	ring->mapped = NULL;
+	if(GLAD_GL_ARB_buffer_storage) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_READ_BUFFER, BGL_UploadRingSize, NULL, flags);
+		ring->mapped = glMapBufferRange(GL_COPY_READ_BUFFER, 0, BGL_UploadRingSize, flags);
+	} else {
+		glBufferData(GL_COPY_READ_BUFFER, BGL_UploadRingSize, NULL, GL_STREAM_DRAW);
+	}
+	for(int i = 0; i < BGL_UploadRingSections; i++) {
+		ring->fences[i] = NULL;
+	}
+	ring->section = 0;
+	ring->head = 0;
+	ring->frameUploads = 0;
+	ring->frameBytes = 0;
+	ring->frameStall = 0;
+	ring->totalStall = 0;
+	printf("Mesh uploads use %s\n", ring->mapped ? "a persistently mapped ring" : "buffer orphaning");
+}
 
-	world->lightPos[0] = 100000.f;
-	world->lightPos[1] = 200000.f;
-	world->lightPos[2] = 100000.f;
+void deinitUploadRing(struct UploadRing* ring) {
+	printf("Mesh upload stalls: %.3f ms in total\n", ring->totalStall * 1000);
+	for(int i = 0; i < BGL_UploadRingSections; i++) {
+		if(ring->fences[i]) glDeleteSync(ring->fences[i]);
+	}
+	if(ring->mapped) {
+		glBindBuffer(GL_COPY_READ_BUFFER, ring->buffer);
+		glUnmapBuffer(GL_COPY_READ_BUFFER);
+	}
+	glDeleteBuffers(1, &ring->buffer);
+}
 
-	for(int x = 0; x < BGL_LoadSize; x++) {
-		for(int y = 0; y < BGL_LoadSize; y++) {
-			for(int z = 0; z < BGL_LoadSize; z++) {
-				struct Chunk* chunk = &world->chunks[x][y][z];
-				chunk->isGenerated = false;
-				initChunk(chunk);
-			}
+// Fence the current section and move on to the next one, waiting until the GPU is done reading it
+void advanceUploadRing(struct UploadRing* ring) {
+	ring->fences[ring->section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	ring->section = (ring->section + 1) % BGL_UploadRingSections;
+	ring->head = ring->section * (BGL_UploadRingSize / BGL_UploadRingSections);
+
+	GLsync fence = ring->fences[ring->section];
+	if(!fence) return;
+	double start = glfwGetTime();
+	while(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+	glDeleteSync(fence);
+	ring->fences[ring->section] = NULL;
+	ring->frameStall += glfwGetTime() - start;
+}
+
+// Largest write the ring takes at once, in whole quads
+size_t getUploadRingLimit(const struct UploadRing* ring) {
+	size_t limit = ring->mapped ? BGL_UploadRingSize / BGL_UploadRingSections : BGL_UploadRingSize;
+	return limit / BGL_QuadBytes * BGL_QuadBytes;
+}
+
+// Copy data into the ring and return its offset in ring->buffer
+GLintptr writeUploadRing(struct UploadRing* ring, const void* data, size_t size) {
+	if(ring->mapped) {
+		size_t sectionEnd = (ring->section + 1) * (BGL_UploadRingSize / BGL_UploadRingSections);
+		assert(size <= BGL_UploadRingSize / BGL_UploadRingSections);
+		if(ring->head + size > sectionEnd) advanceUploadRing(ring);
+		memcpy(ring->mapped + ring->head, data, size);
+	} else {
+		assert(size <= BGL_UploadRingSize);
+		glBindBuffer(GL_COPY_READ_BUFFER, ring->buffer);
+		double start = glfwGetTime();
+		if(ring->head + size > BGL_UploadRingSize) {
+			// Orphan the storage instead of waiting for the GPU to finish with it
+			glBufferData(GL_COPY_READ_BUFFER, BGL_UploadRingSize, NULL, GL_STREAM_DRAW);
+			ring->head = 0;
 		}
+		void* target = glMapBufferRange(GL_COPY_READ_BUFFER, ring->head, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		ring->frameStall += glfwGetTime() - start;
+		memcpy(target, data, size);
+		glUnmapBuffer(GL_COPY_READ_BUFFER);
 	}
+
+	GLintptr offset = ring->head;
+	ring->head += size;
+	ring->frameUploads++;
+	ring->frameBytes += size;
+	return offset;
 }
 
-void generateCosineTerrain(struct Chunk* chunk) { // <----------- Possible optimization. Traverse memory block differently
-	//Previous memory should be cleared
-	const struct Vec3i pos = chunk->position;
-	float x1 = (int)BGL_ChunkSize * pos.x;
-	float y1 = (int)BGL_ChunkSize * pos.y;
-	float z1 = (int)BGL_ChunkSize * pos.z;
-	for(int x = 0; x < BGL_ChunkSize; x++) {
-		for(int z = 0; z < BGL_ChunkSize; z++) {
-			float val = cosf((x + x1)/20.f) * cosf((z + z1)/20.f) * 10 + 20;
-			for(int y = 0; y < BGL_ChunkSize; y++) {
-				unsigned char id;
-				if(val > y + y1) {
-					id = 1;
-				}
-				else {
-					id = 0;
-				}
-				chunk->blocks[x][y][z].id = id;
-			}
+// Call once per frame after the draws, so a section is never reused before the frames reading it have finished
+void endUploadFrame(struct UploadRing* ring) {
+	if(ring->mapped && ring->head != ring->section * (BGL_UploadRingSize / BGL_UploadRingSections)) {
+		advanceUploadRing(ring);
+	}
+	ring->totalStall += ring->frameStall;
+	ring->frameUploads = 0;
+	ring->frameBytes = 0;
+	ring->frameStall = 0;
+}
+
+// Must be called from the thread owning the GL context
+void uploadMesh(struct World* world, struct Chunk* chunk, const GLuint* vertices, const unsigned int faceOffsets[7]) {
+	unsigned int quadCount = faceOffsets[6];
+	memcpy(chunk->faceOffsets, faceOffsets, sizeof(chunk->faceOffsets));
+	if(chunk->indicesSize > 0) {
+		freeArenaRange(&world->arena, chunk->meshOffset, chunk->indicesSize / 6);
+	}
+	chunk->noMesh = quadCount == 0;
+	world->meshQuads += quadCount;
+	world->meshQuads -= chunk->indicesSize / 6;
+	if(chunk->isCached) {
+		world->cachedQuads += quadCount;
+		world->cachedQuads -= chunk->indicesSize / 6;
+	}
+	chunk->indicesSize = quadCount * 6;
+	// Meshes queued before the chunk left the load volume can still arrive
+	if(chunk->isCached) chargeCachedChunk(&world->cache, chunk);
+	if(quadCount == 0) return;
+
+	chunk->meshOffset = allocArenaRange(&world->arena, quadCount);
+	// Meshes of 32 and 64 blocks wide chunks can outgrow a ring section, those are copied over in pieces
+	size_t bytes = (size_t) quadCount * BGL_QuadBytes, limit = getUploadRingLimit(&world->uploads);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, world->arena.VBO);
+	for(size_t done = 0; done < bytes; done += limit) {
+		size_t size = bytes - done < limit ? bytes - done : limit;
+		GLintptr source = writeUploadRing(&world->uploads, (const GLubyte*) vertices + done, size);
+		glBindBuffer(GL_COPY_READ_BUFFER, world->uploads.buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source, chunk->meshOffset * BGL_QuadBytes + done, size);
+	}
+}
+
+/*
+ * Faces of direction i can only point at the camera when the camera is on their front side of some block in the chunk.
+ * Whole direction groups that fail this are left out, and the remaining ones are merged into contiguous draws.
+ */
+void addChunkDraw(struct World* world, const struct Chunk* chunk, const vec3 cameraPosition) {
+	struct DrawList* list = &world->drawList;
+	if(list->count + 3 > list->capacity) resizeDrawList(list, list->capacity / 3 * 2);
+	// Blocks are centered on integer positions
+	int chunkSize = world->chunkSize;
+	float lo[3] = {chunk->position.x * chunkSize - 0.5f, chunk->position.y * chunkSize - 0.5f, chunk->position.z * chunkSize - 0.5f};
+	bool extendLast = false;
+	for(int i = 0; i < 6; i++) {
+		unsigned int quads = chunk->faceOffsets[i + 1] - chunk->faceOffsets[i];
+		if(quads == 0) continue; // Empty groups don't break a run
+
+		int axis = i / 2;
+		bool positive = i % 2 == 0; // See cube_normals
+		if(positive ? cameraPosition[axis] <= lo[axis] : cameraPosition[axis] >= lo[axis] + chunkSize) {
+			list->directionCulledQuads += quads;
+			extendLast = false;
+			continue;
+		}
+
+		list->drawnQuads += quads;
+		if(extendLast) {
+			list->counts[list->count - 1] += quads * 6;
+			continue;
 		}
+		list->counts[list->count] = quads * 6;
+		list->baseVertices[list->count] = (chunk->meshOffset + chunk->faceOffsets[i]) * 4;
+		list->count++;
+		extendLast = true;
 	}
 }
 
-void generatePerlinTerrain(struct Chunk* chunk) { // <----------- Possible optimization. Traverse memory block differently
-	//Previous memory should be cleared
-	const struct Vec3i pos = chunk->position;
-	float x1 = (int)BGL_ChunkSize * pos.x;
-	float y1 = (int)BGL_ChunkSize * pos.y;
-	float z1 = (int)BGL_ChunkSize * pos.z;
-	for(int x = 0; x < BGL_ChunkSize; x++) {
-		for(int z = 0; z < BGL_ChunkSize; z++) {
-			float val = stb_perlin_turbulence_noise3((x1 + x) / 100.f, 0, (z1 + z) / 100.f, 1.3f, 0.8f, 6, 0, 0, 0);
-			for(int y = 0; y < BGL_ChunkSize; y++) {
-				int y2 = y1 + y;
-				unsigned char id = 0;
-				int disToTop = val * 40 - y2 - 20;
-				if (disToTop <= 0) {
-					if(y2 <= 0) {
-						id = 5;
-					}
-					else {
-						id = 0;
-					}
-				} else if (disToTop <= 1) {
-					if(y2 <= 2) {
-						id = 4;
-					}
-					else {
-						id = 2;
-					}
-				} else if (disToTop <= 2) {
-					if(y2 <= 2) {
-						id = 4;
-					}
-					else {
-						id = 3;
-					}
-				} else {
-					id = 1;
-				}
-				chunk->blocks[x][y][z].id = id;
+// Submit and clear the gathered chunk draws
+void drawChunkList(struct World* world) {
+	struct DrawList* list = &world->drawList;
+	if(list->count > 0) {
+		glBindVertexArray(world->arena.VAO);
+		if(list->indirectBuffer) {
+			for(unsigned int i = 0; i < list->count; i++) {
+				list->commands[i] = (struct DrawElementsIndirectCommand){list->counts[i], 1, 0, list->baseVertices[i], 0};
 			}
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, list->indirectBuffer);
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, list->count * sizeof(struct DrawElementsIndirectCommand), list->commands, GL_STREAM_DRAW);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, list->count, 0);
+		} else {
+			glMultiDrawElementsBaseVertex(GL_TRIANGLES, list->counts, GL_UNSIGNED_INT, list->indices, list->count, list->baseVertices);
 		}
+		glBindVertexArray(0);
 	}
+	list->count = 0;
+	list->drawnQuads = 0;
+	list->directionCulledQuads = 0;
 }
 
-void toggleFullscreen(GLFWwindow* window) {
-	if(glfwGetWindowMonitor(window)) {
-		glfwSetWindowMonitor(window, NULL, 320, 240, 640, 480, 0);
-	} else {
-		GLFWmonitor* monitor = glfwGetPrimaryMonitor();
-		const GLFWvidmode* mode = glfwGetVideoMode(monitor);
-		glfwSetWindowMonitor(window, monitor, 0, 0, mode->width, mode->height, mode->refreshRate);
-	}
+void initViewDistanceController(struct ViewDistanceController* controller, double targetFrameTime) {
+	controller->isEnabled = true;
+	controller->targetFrameTime = targetFrameTime;
+	controller->memoryBudget = BGL_ChunkMemoryBudget;
+	controller->frameCount = 0;
+	controller->windowTime = 0;
+	controller->goodWindows = 0;
+	controller->medianFrameTime = 0;
+	controller->p95FrameTime = 0;
+	controller->adjustments = 0;
 }
 
-void toggleCursor(GLFWwindow* window) {
-	if(glfwGetInputMode(window, GLFW_CURSOR) == GLFW_CURSOR_NORMAL)
-		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-	else
-		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+void initChunk(struct Chunk* chunk, const struct Vec3i position, unsigned int size) {
+	initBlockStorage(&chunk->blocks, size, 0);
+	chunk->position = position;
+	chunk->isGenerated = false;
+	chunk->isQueued = false;
+	chunk->isMeshUpToDate = false;
+	chunk->noMesh = true;
+	memset(chunk->faceConnections, 0x3f, sizeof(chunk->faceConnections));
+	chunk->visibleFrame = 0;
+	chunk->meshRevision = 0;
+	chunk->meshOffset = 0;
+	memset(chunk->faceOffsets, 0, sizeof(chunk->faceOffsets));
+	chunk->indicesSize = 0;
+	chunk->nextFree = NULL;
+	chunk->isCached = false;
+	chunk->cacheBytes = 0;
+	chunk->cachePrev = NULL;
+	chunk->cacheNext = NULL;
 }
 
-static void error_callback(int error, const char* description) {
-	fprintf(stderr, "Error: %s\n", description);
+void initChunkMap(struct ChunkMap* map, unsigned int capacity) {
+	map->entries = calloc(capacity, sizeof(struct ChunkMapEntry));
+	map->capacity = capacity;
+	map->count = 0;
 }
 
-static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
-	printf("Key press: %i\n",key);
-	if (key == GLFW_KEY_Q && action == GLFW_PRESS)
-		glfwSetWindowShouldClose(window, GLFW_TRUE);
+void growChunkMap(struct ChunkMap* map) {
+	struct ChunkMapEntry* old = map->entries;
+	unsigned int oldCapacity = map->capacity;
+	initChunkMap(map, oldCapacity * 2);
+	for(unsigned int i = 0; i < oldCapacity; i++) {
+		if(old[i].chunk) {
+			*probeChunkMap(map, old[i].position) = old[i];
+			map->count++;
+		}
+	}
+	free(old);
+}
 
-	if (key == GLFW_KEY_F && action == GLFW_PRESS)
+void removeFromChunkMap(struct ChunkMap* map, const struct Vec3i position) {
+	unsigned int mask = map->capacity - 1;
+	struct ChunkMapEntry* hole = probeChunkMap(map, position);
+	if(!hole->chunk) return;
+	map->count--;
+
+	// Move back every following entry of the run that may no longer be reachable past the hole
+	unsigned int i = hole - map->entries;
+	unsigned int j = i;
+	for(;;) {
+		j = (j + 1) & mask;
+		if(!map->entries[j].chunk) break;
+		unsigned int home = hashChunkPos(map->entries[j].position) & mask;
+		// Stays if its home lies cyclically in (i, j]
+		if(i <= j ? (i < home && home <= j) : (i < home || home <= j)) continue;
+		map->entries[i] = map->entries[j];
+		i = j;
+	}
+	map->entries[i].chunk = NULL;
+}
+
+struct Chunk* allocPoolChunk(struct ChunkPool* pool) {
+	if(!pool->freeChunks) {
+		struct Chunk* page = malloc(BGL_ChunkPoolPageSize * sizeof(struct Chunk));
+		pool->pages = realloc(pool->pages, (pool->pageCount + 1) * sizeof(struct Chunk*));
+		pool->pages[pool->pageCount++] = page;
+		for(int i = BGL_ChunkPoolPageSize - 1; i >= 0; i--) {
+			page[i].nextFree = pool->freeChunks;
+			pool->freeChunks = &page[i];
+		}
+	}
+	struct Chunk* chunk = pool->freeChunks;
+	pool->freeChunks = chunk->nextFree;
+	return chunk;
+}
+
+void freePoolChunk(struct ChunkPool* pool, struct Chunk* chunk) {
+	chunk->nextFree = pool->freeChunks;
+	pool->freeChunks = chunk;
+}
+
+// A new, empty chunk at position, which must not be loaded yet
+struct Chunk* addChunk(struct World* world, const struct Vec3i position) {
+	struct ChunkMap* map = &world->chunks;
+	if((map->count + 1) * 2 > map->capacity) {
+		growChunkMap(map);
+		world->visibilityQueue = realloc(world->visibilityQueue, map->capacity * sizeof(struct VisibilityStep));
+	}
+	struct Chunk* chunk = allocPoolChunk(&world->chunkPool);
+	initChunk(chunk, position, world->chunkSize);
+	world->chunkBlockBytes += getBlockStorageBytes(&chunk->blocks);
+	struct ChunkMapEntry* entry = probeChunkMap(map, position);
+	entry->position = position;
+	entry->chunk = chunk;
+	map->count++;
+	return chunk;
+}
+
+void releaseChunkMesh(struct World* world, struct Chunk* chunk) {
+	if(chunk->indicesSize > 0) {
+		freeArenaRange(&world->arena, chunk->meshOffset, chunk->indicesSize / 6);
+		world->meshQuads -= chunk->indicesSize / 6;
+	}
+	chunk->indicesSize = 0;
+	chunk->noMesh = true;
+	memset(chunk->faceOffsets, 0, sizeof(chunk->faceOffsets));
+}
+
+void uncacheChunk(struct World* world, struct Chunk* chunk) {
+	struct ChunkCache* cache = &world->cache;
+	if(chunk->cachePrev) chunk->cachePrev->cacheNext = chunk->cacheNext; else cache->newest = chunk->cacheNext;
+	if(chunk->cacheNext) chunk->cacheNext->cachePrev = chunk->cachePrev; else cache->oldest = chunk->cachePrev;
+	chunk->cachePrev = NULL;
+	chunk->cacheNext = NULL;
+	chunk->isCached = false;
+	world->chunkBlockBytes += getBlockStorageBytes(&chunk->blocks);
+	world->cachedQuads -= chunk->indicesSize / 6;
+	cache->bytes -= chunk->cacheBytes;
+	cache->count--;
+}
+
+// Unload the chunk with its mesh. Results still coming from the worker threads find no chunk and are dropped
+void removeChunk(struct World* world, struct Chunk* chunk) {
+	if(chunk->isCached) uncacheChunk(world, chunk);
+	releaseChunkMesh(world, chunk);
+	world->chunkBlockBytes -= getBlockStorageBytes(&chunk->blocks);
+	deinitChunk(chunk);
+	removeFromChunkMap(&world->chunks, chunk->position);
+	if(world->lastChunk == chunk) world->lastChunk = NULL;
+	freePoolChunk(&world->chunkPool, chunk);
+}
+
+void initChunkCache(struct ChunkCache* cache, size_t budget, bool keepsMeshes) {
+	cache->newest = NULL;
+	cache->oldest = NULL;
+	cache->count = 0;
+	cache->bytes = 0;
+	cache->budget = budget;
+	cache->keepsMeshes = keepsMeshes;
+	cache->hits = 0;
+	cache->evictions = 0;
+}
+
+void cacheChunk(struct World* world, struct Chunk* chunk) {
+	struct ChunkCache* cache = &world->cache;
+	if(!cache->keepsMeshes) {
+		releaseChunkMesh(world, chunk);
+		chunk->meshRevision = ++world->meshRevision; // Drops meshes still being built
+		chunk->isMeshUpToDate = false;
+	}
+	chunk->isCached = true;
+	world->chunkBlockBytes -= getBlockStorageBytes(&chunk->blocks);
+	world->cachedQuads += chunk->indicesSize / 6;
+	chunk->cacheBytes = 0;
+	chargeCachedChunk(cache, chunk);
+	chunk->cachePrev = NULL;
+	chunk->cacheNext = cache->newest;
+	if(cache->newest) cache->newest->cachePrev = chunk; else cache->oldest = chunk;
+	cache->newest = chunk;
+	cache->count++;
+}
+
+// Unload the least recently left chunks until the cache fits its budget
+void trimChunkCache(struct World* world) {
+	struct ChunkCache* cache = &world->cache;
+	while(cache->bytes > cache->budget && cache->oldest) {
+		removeChunk(world, cache->oldest);
+		cache->evictions++;
+	}
+}
+
+// BGL_LoadRadius scaled to cover the same distance at any chunk size
+int defaultLoadRadius(unsigned int chunkSize) {
+	int radius = BGL_LoadRadius * BGL_DefaultChunkSize / chunkSize;
+	return radius > BGL_MinLoadRadius ? radius : BGL_MinLoadRadius;
+}
+
+void setLoadRadius(struct World* world, int horizontalRadius, int verticalRadius) {
+	if(horizontalRadius < BGL_MinLoadRadius) horizontalRadius = BGL_MinLoadRadius;
+	if(horizontalRadius > BGL_MaxLoadRadius) horizontalRadius = BGL_MaxLoadRadius;
+	if(verticalRadius < BGL_MinLoadRadius) verticalRadius = BGL_MinLoadRadius;
+	if(verticalRadius > BGL_MaxLoadRadius) verticalRadius = BGL_MaxLoadRadius;
+	set(&world->loadRadius, horizontalRadius, verticalRadius, horizontalRadius);
+	world->requestedRadius = world->loadRadius;
+	if(world->viewRadius.x > horizontalRadius - 1) set(&world->viewRadius, horizontalRadius - 1, world->viewRadius.y, horizontalRadius - 1);
+	if(world->viewRadius.y > verticalRadius - 1) world->viewRadius.y = verticalRadius - 1;
+}
+
+// chunkSize must be one of the sizes with specialized code, see getChunkKernels()
+void initWorld(struct World* world, unsigned int chunkSize, int horizontalRadius, int verticalRadius) {
+	world->chunkSize = chunkSize;
+	world->kernels = getChunkKernels(chunkSize);
+	assert(world->kernels);
+	initChunkScratch(&world->scratch);
+	reserveChunkScratch(&world->scratch, chunkSize);
+
+	world->skyColor[0] = 0.1f;
+	world->skyColor[1] = 0.6f;
+	world->skyColor[2] = 0.9f;
+
+	world->lightColor[0] = 1.f;
+	world->lightColor[1] = 1.f;
+	world->lightColor[2] = 1.f;
+
+	world->lightPos[0] = 100000.f;
+	world->lightPos[1] = 200000.f;
+	world->lightPos[2] = 100000.f;
+
+	world->meshMode = BGL_MeshGreedy;
+	world->meshRevision = 0;
+	world->meshQuads = 0;
+	world->cachedQuads = 0;
+	world->chunkBlockBytes = 0;
+	world->quadIndexBuffer = initQuadIndexBuffer(BGL_MaxFaces(chunkSize));
+	initVertexArena(&world->arena, world->quadIndexBuffer);
+	initUploadRing(&world->uploads);
+	world->visibilityFrame = 0;
+
+	initChunkMap(&world->chunks, BGL_ChunkMapInitialCapacity);
+	world->chunkPool.pages = NULL;
+	world->chunkPool.pageCount = 0;
+	world->chunkPool.freeChunks = NULL;
+	world->lastChunk = NULL;
+	initChunkCache(&world->cache, BGL_ChunkCacheBudget, BGL_ChunkCacheMeshes);
+	set(&world->loadCenter, 0, 0, 0);
+	world->visibilityQueue = malloc(world->chunks.capacity * sizeof(struct VisibilityStep));
+	set(&world->viewRadius, BGL_MaxLoadRadius, BGL_MaxLoadRadius, BGL_MaxLoadRadius); // Clamped to the load radius
+	setLoadRadius(world, horizontalRadius, verticalRadius);
+	initViewDistanceController(&world->viewController, BGL_TargetFrameTime);
+	initDrawList(&world->drawList, world->chunks.capacity / 2);
+	world->edits = NULL;
+}
+
+void deinitWorld(struct World* world) {
+	for(unsigned int i = 0; i < world->chunks.capacity; i++) {
+		if(world->chunks.entries[i].chunk) deinitChunk(world->chunks.entries[i].chunk);
+	}
+	free(world->chunks.entries);
+	for(unsigned int i = 0; i < world->chunkPool.pageCount; i++) {
+		free(world->chunkPool.pages[i]);
+	}
+	free(world->chunkPool.pages);
+	free(world->visibilityQueue);
+	deinitChunkScratch(&world->scratch);
+	deinitDrawList(&world->drawList);
+	deinitUploadRing(&world->uploads);
+	deinitVertexArena(&world->arena);
+	glDeleteBuffers(1, &world->quadIndexBuffer);
+}
+
+// Ask for a new load radius, applied at the start of the next frame
+void requestLoadRadius(struct World* world, int horizontalRadius, int verticalRadius) {
+	set(&world->requestedRadius, horizontalRadius, verticalRadius, horizontalRadius);
+}
+
+// Draw up to the given radius and load one chunk further, so every drawn chunk has its neighbours
+void setViewRadius(struct World* world, int horizontalRadius, int verticalRadius) {
+	if(horizontalRadius < BGL_MinLoadRadius - 1) horizontalRadius = BGL_MinLoadRadius - 1;
+	if(horizontalRadius > BGL_MaxLoadRadius - 1) horizontalRadius = BGL_MaxLoadRadius - 1;
+	if(verticalRadius < BGL_MinLoadRadius - 1) verticalRadius = BGL_MinLoadRadius - 1;
+	if(verticalRadius > BGL_MaxLoadRadius - 1) verticalRadius = BGL_MaxLoadRadius - 1;
+	set(&world->viewRadius, horizontalRadius, verticalRadius, horizontalRadius);
+	requestLoadRadius(world, horizontalRadius + 1, verticalRadius + 1);
+}
+
+// Apply a requested radius and move the chunks that have left the load volume around center to the cache
+void updateLoadVolume(struct World* world, const struct Vec3i center) {
+	bool isRadiusChanged = memcmp(&world->requestedRadius, &world->loadRadius, sizeof(struct Vec3i)) != 0;
+	if(!isRadiusChanged && memcmp(&center, &world->loadCenter, sizeof(struct Vec3i)) == 0) return;
+	if(isRadiusChanged) {
+		setLoadRadius(world, world->requestedRadius.x, world->requestedRadius.y);
+		printf("Load radius: %i horizontal, %i vertical\n", world->loadRadius.x, world->loadRadius.y);
+	}
+	world->loadCenter = center;
+
+	// Removal moves entries around, so gather the chunks first
+	unsigned int count = 0;
+	struct Chunk** distant = malloc(world->chunks.count * sizeof(struct Chunk*));
+	for(unsigned int i = 0; i < world->chunks.capacity; i++) {
+		struct Chunk* chunk = world->chunks.entries[i].chunk;
+		if(!chunk) continue;
+		bool isInside = isWithinRadius(chunk->position, center, world->loadRadius);
+		if(isInside && chunk->isCached) {
+			uncacheChunk(world, chunk);
+			world->cache.hits++;
+		} else if(!isInside && !chunk->isCached) {
+			distant[count++] = chunk;
+		}
+	}
+	for(unsigned int i = 0; i < count; i++) {
+		// Chunks still waiting for their blocks would have to be generated again anyway
+		if(distant[i]->isGenerated) {
+			cacheChunk(world, distant[i]);
+		} else {
+			removeChunk(world, distant[i]);
+		}
+	}
+	free(distant);
+	trimChunkCache(world);
+}
+
+// Block data, uploaded meshes and the chunk storage itself, from running totals. Cached chunks have a budget of their own
+// and are left out
+size_t getChunkMemory(const struct World* world) {
+	return (size_t) world->chunkPool.pageCount * BGL_ChunkPoolPageSize * sizeof(struct Chunk) +
+		   world->chunks.capacity * sizeof(struct ChunkMapEntry) + world->chunkBlockBytes +
+		   (size_t) (world->arena.usedQuads - world->cachedQuads) * BGL_QuadBytes;
+}
+
+int compareFrameTimes(const void* a, const void* b) {
+	double x = *(const double*) a, y = *(const double*) b;
+	return (x > y) - (x < y);
+}
+
+// Feed the last frame time. Changes to the view radius apply from the next frame
+void updateViewDistance(struct World* world, double frameTime) {
+	struct ViewDistanceController* controller = &world->viewController;
+	if(!controller->isEnabled) return;
+
+	controller->frameTimes[controller->frameCount++] = frameTime;
+	controller->windowTime += frameTime;
+	if(controller->windowTime < BGL_ViewWindowTime && controller->frameCount < BGL_ViewWindowFrames) return;
+
+	unsigned int count = controller->frameCount;
+	qsort(controller->frameTimes, count, sizeof(double), compareFrameTimes);
+	controller->medianFrameTime = controller->frameTimes[count / 2];
+	controller->p95FrameTime = controller->frameTimes[(count * 95) / 100];
+	controller->frameCount = 0;
+	controller->windowTime = 0;
+	printf("View radius: %i, load radius: %i, frame time median %.2f ms, p95 %.2f ms (target %.2f ms), chunk memory: %zu MB\n",
+		   world->viewRadius.x, world->loadRadius.x, controller->medianFrameTime * 1000, controller->p95FrameTime * 1000,
+		   controller->targetFrameTime * 1000, getChunkMemory(world) >> 20);
+
+	int radius = world->viewRadius.x;
+	if(controller->p95FrameTime > controller->targetFrameTime) {
+		radius--;
+		controller->goodWindows = 0;
+	} else if(controller->p95FrameTime < controller->targetFrameTime * BGL_ViewGrowMargin) {
+		if(++controller->goodWindows >= BGL_ViewGrowWindows) {
+			radius++;
+			controller->goodWindows = 0;
+		}
+	} else {
+		controller->goodWindows = 0;
+	}
+	if(radius < BGL_MinLoadRadius - 1) radius = BGL_MinLoadRadius - 1;
+	if(radius > BGL_MaxLoadRadius - 1) radius = BGL_MaxLoadRadius - 1;
+
+	if(radius != world->viewRadius.x) {
+		printf("View radius: %i -> %i (p95 frame time %.2f ms)\n", world->viewRadius.x, radius, controller->p95FrameTime * 1000);
+		world->viewRadius.x = world->viewRadius.z = radius;
+		controller->adjustments++;
+	}
+
+	// Growing needs the load volume to follow. Shrinking keeps the extra chunks until they cost too much memory
+	if(radius + 1 > world->loadRadius.x ||
+	   (radius + 1 < world->loadRadius.x && getChunkMemory(world) > controller->memoryBudget)) {
+		requestLoadRadius(world, radius + 1, world->loadRadius.y);
+	}
+}
+
+/*
+ * Breadth-first search from the camera chunk over the chunks within drawRadius. A chunk is entered through one face
+ * and left through another only if the two are connected through air, and the search never turns back towards the
+ * camera. Chunks it reaches get visibleFrame set to the new world->visibilityFrame. Chunks without a mesh yet count
+ * as fully open.
+ */
+void findVisibleChunks(struct World* world, const struct Frustum* frustum, const struct Vec3i cameraChunk, const struct Vec3i drawRadius) {
+	unsigned int frame = ++world->visibilityFrame;
+	struct VisibilityStep* queue = world->visibilityQueue;
+	unsigned int head = 0, tail = 0;
+
+	struct Chunk* cameraChunkData = findChunk(world, cameraChunk);
+	if(!cameraChunkData) return;
+	cameraChunkData->visibleFrame = frame;
+	queue[tail++] = (struct VisibilityStep){cameraChunk, -1, 0};
+
+	while(head < tail) {
+		struct VisibilityStep step = queue[head++];
+		const struct Chunk* chunk = findChunk(world, step.position);
+
+		for(int i = 0; i < 6; i++) {
+			if(step.directions & (1 << (i ^ 1))) continue;
+			if(step.entryFace >= 0 && !(chunk->faceConnections[step.entryFace] & (1 << i))) continue;
+
+			int normalIndex = i * 3;
+			struct Vec3i neighbourPos = { step.position.x + cube_normals[0 + normalIndex], step.position.y + cube_normals[1 + normalIndex], step.position.z + cube_normals[2 + normalIndex]};
+			if(!isWithinRadius(neighbourPos, cameraChunk, drawRadius)) continue;
+
+			struct Chunk* neighbour = findChunk(world, neighbourPos);
+			if(!neighbour || neighbour->visibleFrame == frame || !isChunkInFrustum(frustum, neighbourPos, world->chunkSize)) continue;
+
+			neighbour->visibleFrame = frame;
+			// Entered through the face pointing back at this chunk
+			queue[tail++] = (struct VisibilityStep){neighbourPos, i ^ 1, step.directions | (1 << i)};
+		}
+	}
+}
+
+/*
+ * The terrain noise only depends on x and z, so all vertically stacked chunks share one heightmap. Heightmaps are kept
+ * in a fixed size cache with least recently used eviction, shared by all generator threads.
+ */
+#define BGL_HeightmapBucketCount	1024 // Power of two
+
+struct HeightmapTile {
+	float minHeight, maxHeight;
+	int x, z;
+	bool isReady; // False while a thread is computing it
+	int hashNext; // Next tile in the same bucket
+	int lruPrev, lruNext; // Towards most and least recently used
+};
+
+struct HeightmapCache {
+	const struct ChunkKernels* kernels; // Computes missing heightmaps
+	struct HeightmapTile* tiles;
+	float* heights; // chunk size^2 per tile
+	int capacity; // Room for the load volume columns and the ones just left behind
+	int buckets[BGL_HeightmapBucketCount];
+	int lruHead, lruTail; // Most and least recently used tile
+	int tileCount;
+	unsigned long hits, misses;
+	pthread_mutex_t mutex;
+	pthread_cond_t tileReady;
+};
+
+unsigned int heightmapBucket(int x, int z) {
+	unsigned int h = (unsigned int)x * 73856093u ^ (unsigned int)z * 19349663u;
+	return h & (BGL_HeightmapBucketCount - 1);
+}
+
+// Only ever grows. Tiles are linked by index, so they survive the move
+void setHeightmapCacheRadius(struct HeightmapCache* cache, int horizontalRadius) {
+	int capacity = (horizontalRadius * 2 + 1) * (horizontalRadius * 2 + 1) * 2;
+	pthread_mutex_lock(&cache->mutex);
+	if(capacity > cache->capacity) {
+		cache->tiles = realloc(cache->tiles, capacity * sizeof(struct HeightmapTile));
+		cache->heights = realloc(cache->heights, (size_t) capacity * cache->kernels->size * cache->kernels->size * sizeof(float));
+		cache->capacity = capacity;
+	}
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+void initHeightmapCache(struct HeightmapCache* cache, const struct ChunkKernels* kernels, int horizontalRadius) {
+	cache->kernels = kernels;
+	for(int i = 0; i < BGL_HeightmapBucketCount; i++) {
+		cache->buckets[i] = -1;
+	}
+	cache->lruHead = -1;
+	cache->lruTail = -1;
+	cache->tileCount = 0;
+	cache->hits = 0;
+	cache->misses = 0;
+	pthread_mutex_init(&cache->mutex, NULL);
+	pthread_cond_init(&cache->tileReady, NULL);
+	cache->tiles = NULL;
+	cache->heights = NULL;
+	cache->capacity = 0;
+	setHeightmapCacheRadius(cache, horizontalRadius);
+}
+
+void deinitHeightmapCache(struct HeightmapCache* cache) {
+	printf("Heightmap cache: %lu hits, %lu misses\n", cache->hits, cache->misses);
+	free(cache->tiles);
+	free(cache->heights);
+	pthread_cond_destroy(&cache->tileReady);
+	pthread_mutex_destroy(&cache->mutex);
+}
+
+void unlinkHeightmapLRU(struct HeightmapCache* cache, int i) {
+	struct HeightmapTile* tile = &cache->tiles[i];
+	if(tile->lruPrev >= 0) cache->tiles[tile->lruPrev].lruNext = tile->lruNext;
+	else cache->lruHead = tile->lruNext;
+	if(tile->lruNext >= 0) cache->tiles[tile->lruNext].lruPrev = tile->lruPrev;
+	else cache->lruTail = tile->lruPrev;
+}
+
+void pushHeightmapLRU(struct HeightmapCache* cache, int i) {
+	struct HeightmapTile* tile = &cache->tiles[i];
+	tile->lruPrev = -1;
+	tile->lruNext = cache->lruHead;
+	if(cache->lruHead >= 0) cache->tiles[cache->lruHead].lruPrev = i;
+	cache->lruHead = i;
+	if(cache->lruTail < 0) cache->lruTail = i;
+}
+
+// Returns a free tile, evicting the least recently used finished tile if the cache is full
+int allocHeightmapTile(struct HeightmapCache* cache) {
+	if(cache->tileCount < cache->capacity) {
+		return cache->tileCount++;
+	}
+
+	int i = cache->lruTail;
+	while(!cache->tiles[i].isReady) { // Never evict a tile another thread is still computing
+		i = cache->tiles[i].lruPrev;
+		assert(i >= 0);
+	}
+	unlinkHeightmapLRU(cache, i);
+
+	int* link = &cache->buckets[heightmapBucket(cache->tiles[i].x, cache->tiles[i].z)];
+	while(*link != i) {
+		link = &cache->tiles[*link].hashNext;
+	}
+	*link = cache->tiles[i].hashNext;
+	return i;
+}
+
+// Copy the heightmap of chunk column (x, z) into map, computing it on a miss
+void getHeightmap(struct HeightmapCache* cache, struct Heightmap* map, int x, int z) {
+	size_t area = cache->kernels->size * cache->kernels->size;
+	pthread_mutex_lock(&cache->mutex);
+	unsigned int bucket = heightmapBucket(x, z);
+	int i;
+	for(;;) {
+		i = cache->buckets[bucket];
+		while(i >= 0 && (cache->tiles[i].x != x || cache->tiles[i].z != z)) {
+			i = cache->tiles[i].hashNext;
+		}
+		if(i < 0 || cache->tiles[i].isReady) break;
+		// Another thread is computing this column. Wait instead of doing the same work twice, then look it up again
+		// since the tile may have been recycled in the meantime
+		pthread_cond_wait(&cache->tileReady, &cache->mutex);
+	}
+
+	if(i >= 0) {
+		cache->hits++;
+		unlinkHeightmapLRU(cache, i);
+		pushHeightmapLRU(cache, i);
+		memcpy(map->heights, &cache->heights[i * area], area * sizeof(float));
+		map->minHeight = cache->tiles[i].minHeight;
+		map->maxHeight = cache->tiles[i].maxHeight;
+		pthread_mutex_unlock(&cache->mutex);
+		return;
+	}
+
+	cache->misses++;
+	i = allocHeightmapTile(cache);
+	struct HeightmapTile* tile = &cache->tiles[i];
+	tile->x = x;
+	tile->z = z;
+	tile->isReady = false;
+	tile->hashNext = cache->buckets[bucket];
+	cache->buckets[bucket] = i;
+	pushHeightmapLRU(cache, i);
+	pthread_mutex_unlock(&cache->mutex);
+
+	// The tile is pending, so it can't be evicted or written by anyone else while the noise is evaluated unlocked
+	cache->kernels->generateHeightmap(map, x, z);
+
+	pthread_mutex_lock(&cache->mutex);
+	tile = &cache->tiles[i]; // The cache may have grown meanwhile
+	memcpy(&cache->heights[i * area], map->heights, area * sizeof(float));
+	tile->minHeight = map->minHeight;
+	tile->maxHeight = map->maxHeight;
+	tile->isReady = true;
+	pthread_cond_broadcast(&cache->tileReady);
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+/*
+ * Generated chunks can be cached on disk in region files of 32^3 chunks each, so a chunk coming back into range is read
+ * instead of generated again. The cache is off by default and lives in its own directory under the save, which can be
+ * deleted at any time: the edit log is the save, and the generator rebuilds the rest. A region file starts with a fixed
+ * size index holding the offset and size of every chunk's payload, followed by the payloads in the order they were
+ * written. Generator threads read through a memory mapping of the file. Writes are queued to a background thread, which
+ * appends the payload, then publishes it in the index, and rewrites the file without the dead payloads once they make
+ * up most of it.
+ */
+#define BGL_RegionSize			32 // Chunks per axis
+#define BGL_RegionChunks		(BGL_RegionSize * BGL_RegionSize * BGL_RegionSize)
+#define BGL_RegionMagic			0x52474c42 // "BGLR"
+#define BGL_RegionVersion		1
+#define BGL_RegionMapSize		((size_t) 1 << 30) // Address space reserved per file, payloads never go past it
+#define BGL_RegionCompactBytes	(1 << 20) // Dead payload bytes before a file is worth rewriting
+#define BGL_SaveDirectory		"world"
+#define BGL_TerrainCache		false // Whether generated chunks are kept in region files
+#define BGL_TerrainDirectory	"terrain" // Of the region files, under the save directory
+
+struct RegionEntry {
+	uint32_t offset; // 0 when the chunk isn't stored
+	uint32_t size;
+};
+
+struct RegionHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t chunkSize;
+	uint32_t layout; // BGL_BlockLayout the payloads were packed in
+	struct RegionEntry entries[BGL_RegionChunks];
+};
+
+struct Region {
+	struct Vec3i position; // In regions
+	int fd; // -1 while the file doesn't exist
+	const uint8_t* map; // BGL_RegionMapSize bytes, only the first fileSize are backed
+	size_t fileSize;
+	size_t liveBytes; // Header and the payloads the index points at
+	bool isInvalid; // Unreadable file, left alone
+};
+
+struct RegionWrite {
+	struct Vec3i position; // Chunk
+	uint8_t* payload;
+	uint32_t size;
+	struct RegionWrite* next;
+};
+
+struct RegionStore {
+	char directory[256];
+	unsigned int chunkSize; // Files of other sizes have other names
+	pthread_rwlock_t lock; // Held for reading while looking up chunks, for writing while changing regions or indices
+	struct Region** regions; // Never freed before the store, so pointers stay valid
+	unsigned int regionCount, regionCapacity;
+	pthread_t writer;
+	pthread_mutex_t queueMutex;
+	pthread_cond_t writeAvailable;
+	struct RegionWrite* writes; // FIFO
+	struct RegionWrite* lastWrite;
+	bool shutdown;
+	_Atomic unsigned long loads;
+	unsigned long saves, compactions;
+};
+
+/*
+ * Chunk payload: palette size and index width, the palette, then the index words run-length encoded. A token with the
+ * high bit set repeats the following word, otherwise it counts the literal words that follow.
+ */
+struct StoredChunk {
+	uint16_t paletteSize;
+	uint8_t bits;
+	uint8_t reserved;
+};
+
+uint8_t* encodeChunk(const struct BlockStorage* blocks, uint32_t* size) {
+	unsigned int wordCount = storageVolume(blocks) * blocks->bits / 32;
+	uint8_t* data = malloc(sizeof(struct StoredChunk) + blocks->paletteSize * sizeof(uint16_t) + wordCount * 6);
+	struct StoredChunk prefix = {blocks->paletteSize, blocks->bits, 0};
+	memcpy(data, &prefix, sizeof(prefix));
+	uint8_t* out = data + sizeof(prefix);
+	memcpy(out, blocks->palette, blocks->paletteSize * sizeof(uint16_t));
+	out += blocks->paletteSize * sizeof(uint16_t);
+
+	const uint32_t* words = blocks->words;
+	unsigned int i = 0;
+	while(i < wordCount) {
+		unsigned int run = 1;
+		while(i + run < wordCount && run < 0x7fff && words[i + run] == words[i]) run++;
+		if(run > 1) {
+			uint16_t token = 0x8000 | run;
+			memcpy(out, &token, sizeof(token));
+			memcpy(out + sizeof(token), &words[i], sizeof(uint32_t));
+			out += sizeof(token) + sizeof(uint32_t);
+			i += run;
+			continue;
+		}
+		// Literals up to the next pair of equal words
+		unsigned int count = 1;
+		while(i + count < wordCount && count < 0x7fff && (i + count + 1 >= wordCount || words[i + count] != words[i + count + 1])) count++;
+		uint16_t token = count;
+		memcpy(out, &token, sizeof(token));
+		memcpy(out + sizeof(token), &words[i], count * sizeof(uint32_t));
+		out += sizeof(token) + count * sizeof(uint32_t);
+		i += count;
+	}
+	*size = out - data;
+	return data;
+}
+
+// Checks the payload against its size, and the palette ids and indices against their ranges, since it comes from disk
+bool decodeChunk(const uint8_t* data, uint32_t size, unsigned int chunkSize, struct BlockStorage* blocks) {
+	unsigned int volume = chunkSize * chunkSize * chunkSize;
+	struct StoredChunk prefix;
+	if(size < sizeof(prefix)) return false;
+	memcpy(&prefix, data, sizeof(prefix));
+	unsigned int bits = prefix.bits;
+	if((bits != 0 && bits != 1 && bits != 2 && bits != 4 && bits != 8 && bits != 16) ||
+	   prefix.paletteSize == 0 || prefix.paletteSize > paletteCapacity(bits, volume)) return false;
+	const uint8_t* in = data + sizeof(prefix);
+	const uint8_t* end = data + size;
+	if((size_t)(end - in) < prefix.paletteSize * sizeof(uint16_t)) return false;
+
+	blocks->palette = malloc(paletteCapacity(bits, volume) * sizeof(uint16_t));
+	memcpy(blocks->palette, in, prefix.paletteSize * sizeof(uint16_t));
+	in += prefix.paletteSize * sizeof(uint16_t);
+	for(unsigned int i = 0; i < prefix.paletteSize; i++) {
+		if(blocks->palette[i] >= BGL_BlockCount) {
+			free(blocks->palette);
+			return false;
+		}
+	}
+	blocks->paletteSize = prefix.paletteSize;
+	blocks->bits = bits;
+	blocks->words = NULL;
+	blocks->size = chunkSize;
+	if(bits == 0) {
+		if(in == end) return true;
+		deinitBlockStorage(blocks);
+		return false;
+	}
+
+	unsigned int wordCount = volume * bits / 32;
+	blocks->words = malloc(wordCount * sizeof(uint32_t));
+	unsigned int i = 0;
+	while(i < wordCount && end - in >= (ptrdiff_t) sizeof(uint16_t)) {
+		uint16_t token;
+		memcpy(&token, in, sizeof(token));
+		in += sizeof(token);
+		unsigned int count = token & 0x7fff;
+		if(count == 0 || count > wordCount - i) break; // Runs may not go past the chunk
+		if(token & 0x8000) {
+			if(end - in < (ptrdiff_t) sizeof(uint32_t)) break;
+			uint32_t word;
+			memcpy(&word, in, sizeof(word));
+			in += sizeof(word);
+			for(unsigned int k = 0; k < count; k++) blocks->words[i + k] = word;
+		} else {
+			if((size_t)(end - in) < count * sizeof(uint32_t)) break;
+			memcpy(&blocks->words[i], in, count * sizeof(uint32_t));
+			in += count * sizeof(uint32_t);
+		}
+		i += count;
+	}
+	bool isValid = i == wordCount && in == end;
+	for(unsigned int k = 0; k < volume && isValid; k++) {
+		isValid = getBlockIndexBits(blocks, k) < blocks->paletteSize;
+	}
+	if(isValid) return true;
+	deinitBlockStorage(blocks);
+	return false;
+}
+
+// Named after the chunk size too, so worlds of different sizes can share a directory
+void regionPath(const struct RegionStore* store, const struct Vec3i position, const char* suffix, char* path, size_t size) {
+	snprintf(path, size, "%s/r%u.%i.%i.%i.bgr%s", store->directory, store->chunkSize, position.x, position.y, position.z, suffix);
+}
+
+struct Vec3i toRegionPos(const struct Vec3i chunkPos) {
+	struct Vec3i pos = {(chunkPos.x - modulo(chunkPos.x, BGL_RegionSize)) / BGL_RegionSize,
+						(chunkPos.y - modulo(chunkPos.y, BGL_RegionSize)) / BGL_RegionSize,
+						(chunkPos.z - modulo(chunkPos.z, BGL_RegionSize)) / BGL_RegionSize};
+	return pos;
+}
+
+unsigned int regionEntryIndex(const struct Vec3i chunkPos) {
+	return (modulo(chunkPos.x, BGL_RegionSize) * BGL_RegionSize + modulo(chunkPos.y, BGL_RegionSize)) * BGL_RegionSize + modulo(chunkPos.z, BGL_RegionSize);
+}
+
+const struct RegionHeader* getRegionHeader(const struct Region* region) {
+	return (const struct RegionHeader*) region->map;
+}
+
+/*
+ * Whether an index entry points at a payload inside the file. The index is published without syncing the payload
+ * first, so after a crash or a truncation entries can point past the end, and reading those through the map would
+ * raise SIGBUS. Needs a lock, since the writer thread grows fileSize.
+ */
+bool isRegionEntryValid(const struct Region* region, const struct RegionEntry entry) {
+	return entry.offset >= sizeof(struct RegionHeader) && entry.size > 0 &&
+		   (size_t) entry.offset + entry.size <= region->fileSize;
+}
+
+// Open and map the region file, creating it if asked to. Leaves fd at -1 if there is none. Needs the write lock
+void openRegionFile(struct RegionStore* store, struct Region* region, bool create) {
+	char path[300];
+	regionPath(store, region->position, "", path, sizeof(path));
+	region->fd = open(path, O_RDWR | (create ? O_CREAT : 0), 0644);
+	if(region->fd < 0) return;
+
+	struct stat st;
+	fstat(region->fd, &st);
+	region->fileSize = st.st_size;
+	if(region->fileSize == 0) {
+		struct RegionHeader header = {BGL_RegionMagic, BGL_RegionVersion, store->chunkSize, BGL_BlockLayout};
+		if(ftruncate(region->fd, sizeof(struct RegionHeader)) == 0 &&
+		   pwrite(region->fd, &header, offsetof(struct RegionHeader, entries), 0) > 0) {
+			region->fileSize = sizeof(struct RegionHeader);
+		}
+	}
+
+	void* map = region->fileSize >= sizeof(struct RegionHeader) ? mmap(NULL, BGL_RegionMapSize, PROT_READ, MAP_SHARED, region->fd, 0) : MAP_FAILED;
+	const struct RegionHeader* header = map != MAP_FAILED ? map : NULL;
+	if(!header || header->magic != BGL_RegionMagic || header->version != BGL_RegionVersion || header->chunkSize != store->chunkSize ||
+	   header->layout != BGL_BlockLayout) {
+		printf("Ignoring unreadable region file %s\n", path);
+		if(header) munmap(map, BGL_RegionMapSize);
+		close(region->fd);
+		region->fd = -1;
+		region->isInvalid = true;
+		return;
+	}
+	region->map = map;
+	region->liveBytes = sizeof(struct RegionHeader);
+	for(unsigned int i = 0; i < BGL_RegionChunks; i++) {
+		const struct RegionEntry entry = header->entries[i];
+		if(entry.offset == 0) continue;
+		if(isRegionEntryValid(region, entry)) {
+			region->liveBytes += entry.size;
+		} else {
+			// Cleared so a later append can't bring it back into range over some other payload
+			const struct RegionEntry empty = {0, 0};
+			if(pwrite(region->fd, &empty, sizeof(empty), offsetof(struct RegionHeader, entries) + i * sizeof(empty)) != sizeof(empty)) {
+				printf("Could not clear chunk entry %u of region file %s\n", i, path);
+			}
+		}
+	}
+}
+
+struct Region* findRegion(const struct RegionStore* store, const struct Vec3i position) {
+	for(unsigned int i = 0; i < store->regionCount; i++) {
+		if(memcmp(&store->regions[i]->position, &position, sizeof(struct Vec3i)) == 0) return store->regions[i];
+	}
+	return NULL;
+}
+
+// Needs the write lock
+struct Region* addRegion(struct RegionStore* store, const struct Vec3i position, bool create) {
+	if(store->regionCount == store->regionCapacity) {
+		store->regionCapacity = store->regionCapacity ? store->regionCapacity * 2 : 16;
+		store->regions = realloc(store->regions, store->regionCapacity * sizeof(struct Region*));
+	}
+	struct Region* region = malloc(sizeof(struct Region));
+	region->position = position;
+	region->fd = -1;
+	region->map = NULL;
+	region->fileSize = 0;
+	region->liveBytes = 0;
+	region->isInvalid = false;
+	store->regions[store->regionCount++] = region;
+	openRegionFile(store, region, create);
+	return region;
+}
+
+// Read a stored chunk into blocks. Called from the generator threads
+bool loadStoredChunk(struct RegionStore* store, const struct Vec3i chunkPos, struct BlockStorage* blocks) {
+	struct Vec3i regionPos = toRegionPos(chunkPos);
+	pthread_rwlock_rdlock(&store->lock);
+	struct Region* region = findRegion(store, regionPos);
+	if(!region) {
+		pthread_rwlock_unlock(&store->lock);
+		pthread_rwlock_wrlock(&store->lock);
+		if(!findRegion(store, regionPos)) addRegion(store, regionPos, false);
+		pthread_rwlock_unlock(&store->lock);
+		pthread_rwlock_rdlock(&store->lock);
+		region = findRegion(store, regionPos);
+	}
+
+	bool isLoaded = false;
+	if(region->map) {
+		struct RegionEntry entry = getRegionHeader(region)->entries[regionEntryIndex(chunkPos)];
+		if(entry.offset != 0) {
+			isLoaded = isRegionEntryValid(region, entry) && decodeChunk(region->map + entry.offset, entry.size, store->chunkSize, blocks);
+			if(!isLoaded) printf("Regenerating unreadable chunk %i %i %i\n", chunkPos.x, chunkPos.y, chunkPos.z);
+		}
+	}
+	pthread_rwlock_unlock(&store->lock);
+	if(isLoaded) atomic_fetch_add_explicit(&store->loads, 1, memory_order_relaxed);
+	return isLoaded;
+}
+
+// Queue the chunk for writing. Returns right away, the blocks can be used again
+void storeChunk(struct RegionStore* store, const struct Vec3i chunkPos, const struct BlockStorage* blocks) {
+	struct RegionWrite* write = malloc(sizeof(struct RegionWrite));
+	write->position = chunkPos;
+	write->payload = encodeChunk(blocks, &write->size);
+	write->next = NULL;
+
+	pthread_mutex_lock(&store->queueMutex);
+	if(store->writes) {
+		store->lastWrite->next = write;
+	} else {
+		store->writes = write;
+	}
+	store->lastWrite = write;
+	pthread_cond_signal(&store->writeAvailable);
+	pthread_mutex_unlock(&store->queueMutex);
+}
+
+// Rewrite the file with only the payloads the index points at, then swap it in. Writer thread only
+void compactRegion(struct RegionStore* store, struct Region* region) {
+	char path[300], tempPath[300];
+	regionPath(store, region->position, "", path, sizeof(path));
+	regionPath(store, region->position, ".tmp", tempPath, sizeof(tempPath));
+	int fd = open(tempPath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) return;
+
+	// Only this thread changes the file, so it can be read without the lock
+	struct RegionHeader* header = malloc(sizeof(struct RegionHeader));
+	memcpy(header, getRegionHeader(region), sizeof(struct RegionHeader));
+	size_t offset = sizeof(struct RegionHeader);
+	bool isWritten = true;
+	for(unsigned int i = 0; i < BGL_RegionChunks && isWritten; i++) {
+		struct RegionEntry* entry = &header->entries[i];
+		if(entry->offset == 0) continue;
+		if(!isRegionEntryValid(region, *entry)) {
+			// Left behind by a crash, the chunk gets generated again
+			entry->offset = 0;
+			entry->size = 0;
+			continue;
+		}
+		isWritten = pwrite(fd, region->map + entry->offset, entry->size, offset) == (ssize_t) entry->size;
+		entry->offset = offset;
+		offset += entry->size;
+	}
+	isWritten = isWritten && pwrite(fd, header, sizeof(struct RegionHeader), 0) == sizeof(struct RegionHeader);
+	free(header);
+	void* map = isWritten ? mmap(NULL, BGL_RegionMapSize, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+	if(map == MAP_FAILED || rename(tempPath, path) != 0) {
+		if(map != MAP_FAILED) munmap(map, BGL_RegionMapSize);
+		close(fd);
+		unlink(tempPath);
+		return;
+	}
+
+	pthread_rwlock_wrlock(&store->lock);
+	munmap((void*) region->map, BGL_RegionMapSize);
+	close(region->fd);
+	region->fd = fd;
+	region->map = map;
+	region->fileSize = offset;
+	region->liveBytes = offset;
+	pthread_rwlock_unlock(&store->lock);
+	store->compactions++;
+}
+
+void writeRegionChunk(struct RegionStore* store, const struct RegionWrite* write) {
+	struct Vec3i regionPos = toRegionPos(write->position);
+	pthread_rwlock_wrlock(&store->lock);
+	struct Region* region = findRegion(store, regionPos);
+	if(!region) {
+		region = addRegion(store, regionPos, true);
+	} else if(region->fd < 0 && !region->isInvalid) {
+		openRegionFile(store, region, true);
+	}
+	pthread_rwlock_unlock(&store->lock);
+	if(region->fd < 0 || region->fileSize + write->size > BGL_RegionMapSize) return;
+
+	// The payload goes past everything the index points at, so readers can't see it until the entry is written
+	if(pwrite(region->fd, write->payload, write->size, region->fileSize) != (ssize_t) write->size) return;
+	unsigned int index = regionEntryIndex(write->position);
+	struct RegionEntry entry = {region->fileSize, write->size};
+	pthread_rwlock_wrlock(&store->lock);
+	struct RegionEntry oldEntry = getRegionHeader(region)->entries[index];
+	uint32_t oldSize = isRegionEntryValid(region, oldEntry) ? oldEntry.size : 0;
+	bool isPublished = pwrite(region->fd, &entry, sizeof(entry), offsetof(struct RegionHeader, entries) + index * sizeof(entry)) == sizeof(entry);
+	// Grown under the lock so readers never check an entry against a stale size
+	if(isPublished) region->fileSize += write->size;
+	pthread_rwlock_unlock(&store->lock);
+	if(!isPublished) return;
+	region->liveBytes += write->size - oldSize;
+	store->saves++;
+
+	size_t deadBytes = region->fileSize - region->liveBytes;
+	if(deadBytes > BGL_RegionCompactBytes && deadBytes > region->liveBytes) compactRegion(store, region);
+}
+
+void* regionWriter(void* arg) {
+	struct RegionStore* store = arg;
+	pthread_mutex_lock(&store->queueMutex);
+	for(;;) {
+		while(!store->writes && !store->shutdown) {
+			pthread_cond_wait(&store->writeAvailable, &store->queueMutex);
+		}
+		if(!store->writes) break; // Only leaves once everything queued is written
+
+		struct RegionWrite* write = store->writes;
+		store->writes = NULL;
+		pthread_mutex_unlock(&store->queueMutex);
+		while(write) {
+			struct RegionWrite* next = write->next;
+			writeRegionChunk(store, write);
+			free(write->payload);
+			free(write);
+			write = next;
+		}
+		pthread_mutex_lock(&store->queueMutex);
+	}
+	pthread_mutex_unlock(&store->queueMutex);
+	return NULL;
+}
+
+void initRegionStore(struct RegionStore* store, const char* directory, unsigned int chunkSize) {
+	snprintf(store->directory, sizeof(store->directory), "%s", directory);
+	store->chunkSize = chunkSize;
+	if(mkdir(directory, 0755) != 0 && errno != EEXIST) {
+		printf("Can't create terrain cache directory %s, chunks won't be cached\n", directory);
+	}
+	pthread_rwlock_init(&store->lock, NULL);
+	store->regions = NULL;
+	store->regionCount = 0;
+	store->regionCapacity = 0;
+	pthread_mutex_init(&store->queueMutex, NULL);
+	pthread_cond_init(&store->writeAvailable, NULL);
+	store->writes = NULL;
+	store->lastWrite = NULL;
+	store->shutdown = false;
+	atomic_init(&store->loads, 0);
+	store->saves = 0;
+	store->compactions = 0;
+	pthread_create(&store->writer, NULL, regionWriter, store);
+	printf("Caching terrain in %s\n", directory);
+}
+
+// Writes out everything still queued first
+void deinitRegionStore(struct RegionStore* store) {
+	pthread_mutex_lock(&store->queueMutex);
+	store->shutdown = true;
+	pthread_cond_signal(&store->writeAvailable);
+	pthread_mutex_unlock(&store->queueMutex);
+	pthread_join(store->writer, NULL);
+
+	printf("Region files: %lu chunks loaded, %lu saved, %lu compactions\n", atomic_load(&store->loads), store->saves, store->compactions);
+	for(unsigned int i = 0; i < store->regionCount; i++) {
+		struct Region* region = store->regions[i];
+		if(region->map) munmap((void*) region->map, BGL_RegionMapSize);
+		if(region->fd >= 0) close(region->fd);
+		free(region);
+	}
+	free(store->regions);
+	pthread_cond_destroy(&store->writeAvailable);
+	pthread_mutex_destroy(&store->queueMutex);
+	pthread_rwlock_destroy(&store->lock);
+}
+
+/*
+ * Player edits are kept apart from the terrain, which the generator can always rebuild from the chunk position. Every
+ * edit is appended to a write-ahead log as one fixed-size record holding the block position, so the log reads the same
+ * at any chunk size, and a chunk coming back from the generator gets the edits for its position replayed over it. Once
+ * most records in the file have been overwritten by later edits of the same blocks, the writer thread rewrites the log
+ * from its own records with only the latest edit per block. All file access happens on that thread.
+ */
+#define BGL_EditLogMagic			0x454c4742 // "BGLE"
+#define BGL_EditLogVersion			1
+#define BGL_EditLogFile				"edits.wal"
+#define BGL_EditMapInitialCapacity	64 // Power of two
+#define BGL_EditLogCompactRecords	4096 // Records in the file before it is worth rewriting
+
+struct EditLogHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t layout; // BGL_BlockLayout of the build that wrote the log
+};
+
+// The latest record for a block wins
+struct EditRecord {
+	int32_t x, y, z; // Block
+	uint16_t id;
+	uint16_t reserved;
+};
+
+struct BlockEdit {
+	uint32_t index; // blockIndex within the chunk
+	uint16_t id;
+};
+
+struct ChunkEdits {
+	struct Vec3i position;
+	struct BlockEdit* edits; // NULL while the slot is empty
+	unsigned int count, capacity;
+};
+
+struct EditLog {
+	unsigned int chunkSize; // Of the chunks edits are grouped by in memory
+	struct ChunkEdits* chunks; // Open addressing like the chunk map. Main thread only
+	unsigned int chunkCapacity, chunkCount;
+	unsigned long editCount; // Latest edit of every edited block
+	unsigned long loggedRecords; // Records in the file or queued for it, including overwritten ones
+	char path[300];
+	int fd; // -1 when edits can't be saved
+	bool isWritable; // Whether fd was opened at startup, the writer may replace fd later
+	pthread_t writer;
+	pthread_mutex_t mutex;
+	pthread_cond_t writeAvailable;
+	struct EditRecord* pending; // Appended by the main thread, taken whole by the writer
+	unsigned int pendingCount, pendingCapacity;
+	bool isCompactionQueued; // The writer rewrites the file once pending is appended
+	bool shutdown;
+	unsigned long fileBytes, compactions; // Writer thread
+};
+
+// Slot holding position, or the empty slot where it would go
+struct ChunkEdits* probeEditMap(const struct EditLog* log, const struct Vec3i position) {
+	unsigned int mask = log->chunkCapacity - 1;
+	unsigned int i = hashChunkPos(position) & mask;
+	while(log->chunks[i].edits && memcmp(&log->chunks[i].position, &position, sizeof(struct Vec3i)) != 0) {
+		i = (i + 1) & mask;
+	}
+	return &log->chunks[i];
+}
+
+void growEditMap(struct EditLog* log) {
+	struct ChunkEdits* old = log->chunks;
+	unsigned int oldCapacity = log->chunkCapacity;
+	log->chunkCapacity *= 2;
+	log->chunks = calloc(log->chunkCapacity, sizeof(struct ChunkEdits));
+	for(unsigned int i = 0; i < oldCapacity; i++) {
+		if(old[i].edits) *probeEditMap(log, old[i].position) = old[i];
+	}
+	free(old);
+}
+
+// Update the in-memory edits only
+void setChunkEdit(struct EditLog* log, const struct Vec3i position, unsigned int index, unsigned short id) {
+	if((log->chunkCount + 1) * 2 > log->chunkCapacity) growEditMap(log);
+	struct ChunkEdits* chunk = probeEditMap(log, position);
+	if(!chunk->edits) {
+		chunk->position = position;
+		chunk->capacity = 8;
+		chunk->count = 0;
+		chunk->edits = malloc(chunk->capacity * sizeof(struct BlockEdit));
+		log->chunkCount++;
+	}
+	for(unsigned int i = 0; i < chunk->count; i++) {
+		if(chunk->edits[i].index == index) {
+			chunk->edits[i].id = id;
+			return;
+		}
+	}
+	if(chunk->count == chunk->capacity) {
+		chunk->capacity *= 2;
+		chunk->edits = realloc(chunk->edits, chunk->capacity * sizeof(struct BlockEdit));
+	}
+	chunk->edits[chunk->count++] = (struct BlockEdit) {index, id};
+	log->editCount++;
+}
+
+// Update the in-memory edits from a record of the file
+void setRecordEdit(struct EditLog* log, const struct EditRecord* record) {
+	int size = log->chunkSize;
+	int local[3] = {modulo(record->x, size), modulo(record->y, size), modulo(record->z, size)};
+	struct Vec3i position = {(record->x - local[0]) / size, (record->y - local[1]) / size, (record->z - local[2]) / size};
+	setChunkEdit(log, position, blockIndex(size, local[0], local[1], local[2]), record->id);
+}
+
+struct EditRecord toEditRecord(const struct EditLog* log, const struct Vec3i position, unsigned int index, unsigned short id) {
+	int size = log->chunkSize;
+	int local[3];
+	blockPosition(index, size, local);
+	return (struct EditRecord) {position.x * size + local[0], position.y * size + local[1], position.z * size + local[2], id, 0};
+}
+
+// Replay the edits of a chunk over its freshly generated blocks
+void applyChunkEdits(const struct EditLog* log, const struct Vec3i position, struct BlockStorage* blocks) {
+	const struct ChunkEdits* chunk = probeEditMap(log, position);
+	if(!chunk->edits) return;
+	for(unsigned int i = 0; i < chunk->count; i++) {
+		setStorageId(blocks, chunk->edits[i].index, chunk->edits[i].id);
+	}
+}
+
+// Remember an edit and queue it for the file. Only touches memory, the writer thread does the rest
+void recordBlockEdit(struct EditLog* log, const struct Vec3i position, unsigned int index, unsigned short id) {
+	setChunkEdit(log, position, index, id);
+	if(!log->isWritable) return;
+	log->loggedRecords++;
+
+	pthread_mutex_lock(&log->mutex);
+	if(log->loggedRecords > BGL_EditLogCompactRecords && log->loggedRecords > log->editCount * 2) {
+		log->isCompactionQueued = true;
+		log->loggedRecords = log->editCount; // What the rewritten file will hold
+	}
+	if(log->pendingCount == log->pendingCapacity) {
+		log->pendingCapacity = log->pendingCapacity ? log->pendingCapacity * 2 : 64;
+		log->pending = realloc(log->pending, log->pendingCapacity * sizeof(struct EditRecord));
+	}
+	log->pending[log->pendingCount++] = toEditRecord(log, position, index, id);
+	pthread_cond_signal(&log->writeAvailable);
+	pthread_mutex_unlock(&log->mutex);
+}
+
+bool writeAll(int fd, const void* data, size_t size) {
+	const uint8_t* bytes = data;
+	while(size > 0) {
+		ssize_t written = write(fd, bytes, size);
+		if(written < 0 && errno == EINTR) continue;
+		if(written <= 0) return false;
+		bytes += written;
+		size -= written;
+	}
+	return true;
+}
+
+// A record of the file with its place in it, so the latest edit of a block sorts last
+struct OrderedEditRecord {
+	struct EditRecord record;
+	uint32_t order;
+};
+
+int compareEditRecords(const void* a, const void* b) {
+	const struct OrderedEditRecord* x = a;
+	const struct OrderedEditRecord* y = b;
+	if(x->record.x != y->record.x) return (x->record.x > y->record.x) - (x->record.x < y->record.x);
+	if(x->record.y != y->record.y) return (x->record.y > y->record.y) - (x->record.y < y->record.y);
+	if(x->record.z != y->record.z) return (x->record.z > y->record.z) - (x->record.z < y->record.z);
+	return (x->order > y->order) - (x->order < y->order);
+}
+
+// Latest valid record of every block in the file, sorted by position. Writer thread only
+struct EditRecord* readLatestEdits(const struct EditLog* log, unsigned int* count) {
+	size_t fileCount = (log->fileBytes - sizeof(struct EditLogHeader)) / sizeof(struct EditRecord);
+	struct EditRecord* records = malloc(fileCount * sizeof(struct EditRecord) + 1);
+	size_t size = fileCount * sizeof(struct EditRecord);
+	if(pread(log->fd, records, size, sizeof(struct EditLogHeader)) != (ssize_t) size) {
+		free(records);
+		return NULL;
+	}
+	struct OrderedEditRecord* ordered = malloc(fileCount * sizeof(struct OrderedEditRecord) + 1);
+	for(size_t i = 0; i < fileCount; i++) {
+		ordered[i] = (struct OrderedEditRecord) {records[i], i};
+	}
+	qsort(ordered, fileCount, sizeof(struct OrderedEditRecord), compareEditRecords);
+	*count = 0;
+	for(size_t i = 0; i < fileCount; i++) {
+		const struct EditRecord* record = &ordered[i].record;
+		bool isOverwritten = i + 1 < fileCount && memcmp(&ordered[i + 1].record, record, 3 * sizeof(int32_t)) == 0;
+		if(!isOverwritten && record->id < BGL_BlockCount) records[(*count)++] = *record;
+	}
+	free(ordered);
+	return records;
+}
+
+// Write the latest edit of every block to a new file and swap it in. Writer thread only
+void compactEditLog(struct EditLog* log) {
+	unsigned int count;
+	struct EditRecord* records = readLatestEdits(log, &count);
+	if(!records) return;
+	char tempPath[310];
+	snprintf(tempPath, sizeof(tempPath), "%s.tmp", log->path);
+	int fd = open(tempPath, O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644);
+	struct EditLogHeader header = {BGL_EditLogMagic, BGL_EditLogVersion, BGL_BlockLayout};
+	if(fd < 0 || !writeAll(fd, &header, sizeof(header)) || !writeAll(fd, records, count * sizeof(struct EditRecord)) ||
+	   fsync(fd) != 0 || rename(tempPath, log->path) != 0) {
+		if(fd >= 0) close(fd);
+		unlink(tempPath);
+		free(records);
+		return;
+	}
+	free(records);
+	close(log->fd);
+	log->fd = fd;
+	log->fileBytes = sizeof(header) + count * sizeof(struct EditRecord);
+	log->compactions++;
+}
+
+void* editLogWriter(void* arg) {
+	struct EditLog* log = arg;
+	pthread_mutex_lock(&log->mutex);
+	for(;;) {
+		while(!log->pendingCount && !log->isCompactionQueued && !log->shutdown) {
+			pthread_cond_wait(&log->writeAvailable, &log->mutex);
+		}
+		if(!log->pendingCount && !log->isCompactionQueued) break; // Only leaves once everything queued is written
+
+		bool isCompacting = log->isCompactionQueued;
+		struct EditRecord* records = log->pending;
+		unsigned int count = log->pendingCount;
+		log->isCompactionQueued = false;
+		log->pending = NULL;
+		log->pendingCount = 0;
+		log->pendingCapacity = 0;
+		pthread_mutex_unlock(&log->mutex);
+
+		if(count > 0 && writeAll(log->fd, records, count * sizeof(struct EditRecord))) {
+			log->fileBytes += count * sizeof(struct EditRecord);
+		}
+		if(isCompacting) compactEditLog(log);
+		free(records);
+		pthread_mutex_lock(&log->mutex);
+	}
+	pthread_mutex_unlock(&log->mutex);
+	return NULL;
+}
+
+// Load the edits of an existing log. A record cut short by a crash is dropped so later appends stay aligned
+void readEditLog(struct EditLog* log) {
+	struct stat info;
+	struct EditLogHeader header;
+	if(fstat(log->fd, &info) != 0) {
+		close(log->fd);
+		log->fd = -1;
+		return;
+	}
+	if((size_t) info.st_size < sizeof(header)) {
+		header = (struct EditLogHeader) {BGL_EditLogMagic, BGL_EditLogVersion, BGL_BlockLayout};
+		if(ftruncate(log->fd, 0) != 0 || !writeAll(log->fd, &header, sizeof(header))) {
+			close(log->fd);
+			log->fd = -1;
+		}
+		log->fileBytes = sizeof(header);
+		return;
+	}
+	if(pread(log->fd, &header, sizeof(header), 0) != sizeof(header) || header.magic != BGL_EditLogMagic ||
+	   header.version != BGL_EditLogVersion || header.layout != BGL_BlockLayout) {
+		// Left untouched rather than overwritten, like a region file of another build
+		printf("Edit log %s is unreadable, edits won't be saved\n", log->path);
+		close(log->fd);
+		log->fd = -1;
+		return;
+	}
+
+	size_t count = (info.st_size - sizeof(header)) / sizeof(struct EditRecord);
+	struct EditRecord* records = malloc(count * sizeof(struct EditRecord) + 1);
+	size_t size = count * sizeof(struct EditRecord);
+	if(pread(log->fd, records, size, sizeof(header)) != (ssize_t) size) count = 0;
+	for(size_t i = 0; i < count; i++) {
+		if(records[i].id >= BGL_BlockCount) continue;
+		setRecordEdit(log, &records[i]);
+	}
+	free(records);
+	log->loggedRecords = count;
+	log->fileBytes = sizeof(header) + count * sizeof(struct EditRecord);
+	if(log->fileBytes != (size_t) info.st_size && ftruncate(log->fd, log->fileBytes) != 0) {
+		close(log->fd);
+		log->fd = -1;
+		return;
+	}
+}
+
+void initEditLog(struct EditLog* log, const char* directory, unsigned int chunkSize) {
+	snprintf(log->path, sizeof(log->path), "%s/" BGL_EditLogFile, directory);
+	if(mkdir(directory, 0755) != 0 && errno != EEXIST) {
+		printf("Can't create save directory %s\n", directory);
+	}
+	log->chunkSize = chunkSize;
+	log->chunkCapacity = BGL_EditMapInitialCapacity;
+	log->chunks = calloc(log->chunkCapacity, sizeof(struct ChunkEdits));
+	log->chunkCount = 0;
+	log->editCount = 0;
+	log->loggedRecords = 0;
+	log->fileBytes = 0;
+	log->compactions = 0;
+	log->fd = open(log->path, O_RDWR | O_CREAT | O_APPEND, 0644);
+	if(log->fd >= 0) {
+		readEditLog(log);
+	} else {
+		printf("Can't open edit log %s, edits won't be saved\n", log->path);
+	}
+	log->isWritable = log->fd >= 0;
+
+	pthread_mutex_init(&log->mutex, NULL);
+	pthread_cond_init(&log->writeAvailable, NULL);
+	log->pending = NULL;
+	log->pendingCount = 0;
+	log->pendingCapacity = 0;
+	log->isCompactionQueued = false;
+	log->shutdown = false;
+	pthread_create(&log->writer, NULL, editLogWriter, log);
+	printf("Loaded %lu block edits in %u chunks from %s\n", log->editCount, log->chunkCount, log->path);
+}
+
+// Writes out everything still queued first
+void deinitEditLog(struct EditLog* log) {
+	pthread_mutex_lock(&log->mutex);
+	log->shutdown = true;
+	pthread_cond_signal(&log->writeAvailable);
+	pthread_mutex_unlock(&log->mutex);
+	pthread_join(log->writer, NULL);
+
+	printf("Edit log: %lu block edits in %u chunks, %lu bytes, %lu compactions\n", log->editCount, log->chunkCount,
+		   log->fileBytes, log->compactions);
+	for(unsigned int i = 0; i < log->chunkCapacity; i++) {
+		free(log->chunks[i].edits);
+	}
+	free(log->chunks);
+	if(log->fd >= 0) close(log->fd);
+	pthread_cond_destroy(&log->writeAvailable);
+	pthread_mutex_destroy(&log->mutex);
+}
+
+#define BGL_ReachDistance	8.f // Blocks
+#define BGL_PlacedBlock		1 // Stone
+
+// Change a block of a generated chunk and log the edit. Returns false outside the generated world
+bool setWorldBlock(struct World* world, int gx, int gy, int gz, unsigned short id) {
+	vec3 globalPos = {gx, gy, gz};
+	int chunkSize = world->chunkSize;
+	struct Vec3i chunkPos = toChunkPos(globalPos, chunkSize);
+	int local[3] = {gx - chunkPos.x * chunkSize, gy - chunkPos.y * chunkSize, gz - chunkPos.z * chunkSize};
+	struct Chunk* chunk = findChunk(world, chunkPos);
+	if(!chunk || !chunk->isGenerated) return false;
+	if(getBlockId(chunk, local[0], local[1], local[2]) == id) return true;
+
+	// The storage widens its indices when the palette outgrows them
+	size_t blockBytes = getBlockStorageBytes(&chunk->blocks);
+	setBlockId(chunk, local[0], local[1], local[2], id);
+	if(chunk->isCached) {
+		chargeCachedChunk(&world->cache, chunk);
+	} else {
+		world->chunkBlockBytes += getBlockStorageBytes(&chunk->blocks) - blockBytes;
+	}
+	chunk->isMeshUpToDate = false;
+	// Neighbours sharing the face of a border block
+	for(int i = 0; i < 6; i++) {
+		int axis = i / 2;
+		if(local[axis] != (i % 2 == 0 ? chunkSize - 1 : 0)) continue;
+		int normalIndex = i * 3;
+		struct Vec3i neighbourPos = { chunkPos.x + cube_normals[0 + normalIndex], chunkPos.y + cube_normals[1 + normalIndex], chunkPos.z + cube_normals[2 + normalIndex]};
+		struct Chunk* neighbour = findChunk(world, neighbourPos);
+		if(neighbour) neighbour->isMeshUpToDate = false;
+	}
+	if(world->edits) recordBlockEdit(world->edits, chunkPos, blockIndex(chunkSize, local[0], local[1], local[2]), id);
+	return true;
+}
+
+/*
+ * Walk the blocks along a ray one boundary crossing at a time. hit gets the first solid block within maxDistance and
+ * previous the block the ray passed through just before it.
+ */
+bool raycastBlock(struct World* world, const vec3 origin, const vec3 direction, float maxDistance, int hit[3], int previous[3]) {
+	int step[3];
+	float next[3], delta[3]; // Ray distance to the next boundary on each axis, and between boundaries
+	for(int a = 0; a < 3; a++) {
+		float p = origin[a] + 0.5f; // Block i spans [i - 0.5, i + 0.5]
+		hit[a] = (int) floorf(p);
+		previous[a] = hit[a];
+		if(direction[a] > 0) {
+			step[a] = 1;
+			delta[a] = 1 / direction[a];
+			next[a] = (hit[a] + 1 - p) * delta[a];
+		} else if(direction[a] < 0) {
+			step[a] = -1;
+			delta[a] = -1 / direction[a];
+			next[a] = (p - hit[a]) * delta[a];
+		} else {
+			step[a] = 0;
+			delta[a] = INFINITY;
+			next[a] = INFINITY;
+		}
+	}
+
+	float distance = 0;
+	while(distance <= maxDistance) {
+		unsigned short id;
+		checkBlock(world, &id, hit[0], hit[1], hit[2]);
+		if(id != 0) return true;
+		int a = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+		memcpy(previous, hit, 3 * sizeof(int));
+		hit[a] += step[a];
+		distance = next[a];
+		next[a] += delta[a];
+	}
+	return false;
+}
+
+// Left click breaks the block in the center of the view, right click places one against it
+void handleBlockInput(struct Camera* cam, GLFWwindow* window, struct World* world, mat4x4 view) {
+	bool isBreaking = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+	bool isPlacing = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+	bool breakClick = isBreaking && !cam->isBreaking;
+	bool placeClick = isPlacing && !cam->isPlacing;
+	cam->isBreaking = isBreaking;
+	cam->isPlacing = isPlacing;
+	if(glfwGetInputMode(window, GLFW_CURSOR) != GLFW_CURSOR_DISABLED || (!breakClick && !placeClick)) return;
+
+	// The camera looks down its -z axis, the third row of the view rotation
+	vec3 direction = {-view[0][2], -view[1][2], -view[2][2]};
+	int hit[3], previous[3];
+	if(!raycastBlock(world, cam->position, direction, BGL_ReachDistance, hit, previous)) return;
+	if(breakClick) {
+		setWorldBlock(world, hit[0], hit[1], hit[2], 0);
+	} else if(memcmp(hit, previous, sizeof(hit)) != 0) {
+		setWorldBlock(world, previous[0], previous[1], previous[2], BGL_PlacedBlock);
+	}
+}
+
+/*
+ * Terrain generation runs on a pool of worker threads. The main thread pushes chunk positions onto a queue ordered
+ * by distance to the camera, and collects the finished blocks at the start of each frame.
+ */
+struct GenerationJob {
+	struct Vec3i position;
+	int priority; // Squared distance to the camera chunk. Lowest is generated first
+};
+
+struct GenerationResult {
+	struct BlockStorage blocks; // Handed over to the chunk
+	struct Vec3i position;
+	struct GenerationResult* next;
+};
+
+struct Generator {
+	pthread_t threads[BGL_MaxWorkerThreads];
+	unsigned int threadCount;
+	pthread_mutex_t mutex;
+	pthread_cond_t jobAvailable;
+	struct GenerationJob* jobs; // Binary min-heap on priority
+	unsigned int jobCount, jobCapacity;
+	struct GenerationResult* results; // Finished chunks waiting to be collected by the main thread
+	const struct ChunkKernels* kernels; // Of the world's chunk size
+	struct HeightmapCache heightmaps;
+	struct Vec3i center;
+	struct Vec3i radius; // Load radius around center
+	struct RegionStore* store; // Checked before generating, NULL to always generate
+	bool shutdown;
+};
+
+int chunkDistance(const struct Vec3i a, const struct Vec3i b) {
+	int dx = a.x - b.x;
+	int dy = a.y - b.y;
+	int dz = a.z - b.z;
+	return dx * dx + dy * dy + dz * dz;
+}
+
+void siftUpJob(struct Generator* gen, unsigned int i) {
+	struct GenerationJob job = gen->jobs[i];
+	while(i > 0) {
+		unsigned int parent = (i - 1) / 2;
+		if(gen->jobs[parent].priority <= job.priority) break;
+		gen->jobs[i] = gen->jobs[parent];
+		i = parent;
+	}
+	gen->jobs[i] = job;
+}
+
+void siftDownJob(struct Generator* gen, unsigned int i) {
+	struct GenerationJob job = gen->jobs[i];
+	for(;;) {
+		unsigned int child = i * 2 + 1;
+		if(child >= gen->jobCount) break;
+		if(child + 1 < gen->jobCount && gen->jobs[child + 1].priority < gen->jobs[child].priority) child++;
+		if(job.priority <= gen->jobs[child].priority) break;
+		gen->jobs[i] = gen->jobs[child];
+		i = child;
+	}
+	gen->jobs[i] = job;
+}
+
+void generateChunkBlocks(struct Generator* gen, const struct Vec3i position, struct BlockStorage* blocks, struct ChunkScratch* scratch) {
+	struct Heightmap map;
+	getHeightmap(&gen->heightmaps, &map, position.x, position.z);
+	gen->kernels->generateChunkBlocks(&map, position, blocks, scratch);
+}
+
+void* generatorWorker(void* arg) {
+	struct Generator* gen = arg;
+	struct ChunkScratch scratch;
+	initChunkScratch(&scratch);
+	reserveChunkScratch(&scratch, gen->kernels->size);
+	pthread_mutex_lock(&gen->mutex);
+	for(;;) {
+		while(gen->jobCount == 0 && !gen->shutdown) {
+			pthread_cond_wait(&gen->jobAvailable, &gen->mutex);
+		}
+		if(gen->shutdown) break;
+
+		struct GenerationJob job = gen->jobs[0];
+		gen->jobs[0] = gen->jobs[--gen->jobCount];
+		siftDownJob(gen, 0);
+		pthread_mutex_unlock(&gen->mutex);
+
+		struct GenerationResult* result = malloc(sizeof(struct GenerationResult));
+		result->position = job.position;
+		if(!gen->store || !loadStoredChunk(gen->store, job.position, &result->blocks)) {
+			generateChunkBlocks(gen, job.position, &result->blocks, &scratch);
+			// Uniform chunks are stored too, so a column read back from disk never needs its heightmap
+			if(gen->store) storeChunk(gen->store, job.position, &result->blocks);
+		}
+
+		pthread_mutex_lock(&gen->mutex);
+		result->next = gen->results;
+		gen->results = result;
+	}
+	pthread_mutex_unlock(&gen->mutex);
+	deinitChunkScratch(&scratch);
+	return NULL;
+}
+
+// Worker threads of the generator and the mesher together
+unsigned int workerThreadCount() {
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	// Leave one core for the render thread
+	unsigned int threadCount = cores > 1 ? (unsigned int)cores - 1 : 1;
+	if(threadCount > BGL_MaxWorkerThreads) threadCount = BGL_MaxWorkerThreads;
+	return threadCount;
+}
+
+// The generator gets the larger half of the workers, since meshes wait for generated chunks. Each pool needs at least
+// one thread, so a single worker is the only case where they share a core
+unsigned int generatorThreadCount() {
+	unsigned int workers = workerThreadCount();
+	return workers - workers / 2;
+}
+
+unsigned int mesherThreadCount() {
+	unsigned int workers = workerThreadCount();
+	return workers > 1 ? workers / 2 : 1;
+}
+
+void initGenerator(struct Generator* gen, const struct ChunkKernels* kernels, const struct Vec3i radius, struct RegionStore* store) {
+	unsigned int threadCount = generatorThreadCount();
+
+	pthread_mutex_init(&gen->mutex, NULL);
+	pthread_cond_init(&gen->jobAvailable, NULL);
+	gen->jobCapacity = (radius.x * 2 + 1) * (radius.y * 2 + 1) * (radius.z * 2 + 1);
+	gen->jobs = malloc(gen->jobCapacity * sizeof(struct GenerationJob));
+	gen->jobCount = 0;
+	gen->results = NULL;
+	gen->kernels = kernels;
+	initHeightmapCache(&gen->heightmaps, kernels, radius.x);
+	set(&gen->center, 0, 0, 0);
+	gen->radius = radius;
+	gen->store = store;
+	gen->shutdown = false;
+
+	gen->threadCount = 0;
+	for(unsigned int i = 0; i < threadCount; i++) {
+		if(pthread_create(&gen->threads[i], NULL, generatorWorker, gen) != 0) break;
+		gen->threadCount++;
+	}
+	assert(gen->threadCount > 0);
+	printf("Started %u terrain generation threads\n", gen->threadCount);
+}
+
+void deinitGenerator(struct Generator* gen) {
+	pthread_mutex_lock(&gen->mutex);
+	gen->shutdown = true;
+	pthread_cond_broadcast(&gen->jobAvailable);
+	pthread_mutex_unlock(&gen->mutex);
+	for(unsigned int i = 0; i < gen->threadCount; i++) {
+		pthread_join(gen->threads[i], NULL);
+	}
+
+	while(gen->results) {
+		struct GenerationResult* next = gen->results->next;
+		deinitBlockStorage(&gen->results->blocks);
+		free(gen->results);
+		gen->results = next;
+	}
+	free(gen->jobs);
+	deinitHeightmapCache(&gen->heightmaps);
+	pthread_cond_destroy(&gen->jobAvailable);
+	pthread_mutex_destroy(&gen->mutex);
+}
+
+void queueGeneration(struct Generator* gen, const struct Vec3i position) {
+	pthread_mutex_lock(&gen->mutex);
+	if(gen->jobCount == gen->jobCapacity) {
+		gen->jobCapacity *= 2;
+		gen->jobs = realloc(gen->jobs, gen->jobCapacity * sizeof(struct GenerationJob));
+	}
+	struct GenerationJob* job = &gen->jobs[gen->jobCount];
+	job->position = position;
+	job->priority = chunkDistance(position, gen->center);
+	siftUpJob(gen, gen->jobCount++);
+	pthread_cond_signal(&gen->jobAvailable);
+	pthread_mutex_unlock(&gen->mutex);
+}
+
+// Re-prioritize the queue around a new camera chunk or load radius and drop jobs that have left the load volume
+void setGeneratorCenter(struct Generator* gen, const struct Vec3i center, const struct Vec3i radius) {
+	if(memcmp(&center, &gen->center, sizeof(struct Vec3i)) == 0 && memcmp(&radius, &gen->radius, sizeof(struct Vec3i)) == 0) return;
+	if(radius.x != gen->radius.x) setHeightmapCacheRadius(&gen->heightmaps, radius.x);
+
+	pthread_mutex_lock(&gen->mutex);
+	gen->center = center;
+	gen->radius = radius;
+	unsigned int count = 0;
+	for(unsigned int i = 0; i < gen->jobCount; i++) {
+		struct GenerationJob job = gen->jobs[i];
+		if(!isWithinRadius(job.position, center, radius)) continue;
+		job.priority = chunkDistance(job.position, center);
+		gen->jobs[count++] = job;
+	}
+	gen->jobCount = count;
+	for(int i = (int)count / 2 - 1; i >= 0; i--) {
+		siftDownJob(gen, i);
+	}
+	pthread_mutex_unlock(&gen->mutex);
+}
+
+bool isChunkGenerated(struct World* world, const struct Vec3i chunkPos) {
+	struct Chunk* chunk = findChunk(world, chunkPos);
+	return chunk && chunk->isGenerated;
+}
+
+// A mesh can only be built once the chunk and all of its neighbours hold their blocks
+bool isChunkMeshable(struct World* world, const struct Vec3i chunkPos) {
+	if(!isChunkGenerated(world, chunkPos)) return false;
+	for(int i = 0; i < 6; i++) {
+		int normalIndex = i * 3;
+		struct Vec3i neighbourPos = { chunkPos.x + cube_normals[0 + normalIndex], chunkPos.y + cube_normals[1 + normalIndex], chunkPos.z + cube_normals[2 + normalIndex]};
+		if(!isChunkGenerated(world, neighbourPos)) return false;
+	}
+	return true;
+}
+
+// Move finished chunks from the worker threads into the world. Never blocks on generation
+void collectGeneratedChunks(struct Generator* gen, struct World* world) {
+	pthread_mutex_lock(&gen->mutex);
+	struct GenerationResult* result = gen->results;
+	gen->results = NULL;
+	pthread_mutex_unlock(&gen->mutex);
+
+	while(result) {
+		struct Chunk* chunk = findChunk(world, result->position);
+		// Discard results for chunks that have been unloaded meanwhile
+		if(chunk && !chunk->isGenerated) {
+			world->chunkBlockBytes -= getBlockStorageBytes(&chunk->blocks);
+			deinitBlockStorage(&chunk->blocks);
+			chunk->blocks = result->blocks;
+			result->blocks.palette = NULL;
+			result->blocks.words = NULL;
+			if(world->edits) applyChunkEdits(world->edits, result->position, &chunk->blocks);
+			world->chunkBlockBytes += getBlockStorageBytes(&chunk->blocks);
+			chunk->isGenerated = true;
+			chunk->isQueued = false;
+			chunk->isMeshUpToDate = false;
+
+			// Faces on the shared border of the neighbours depend on this chunk
+			for(int i = 0; i < 6; i++) {
+				int normalIndex = i * 3;
+				struct Vec3i neighbourPos = { result->position.x + cube_normals[0 + normalIndex], result->position.y + cube_normals[1 + normalIndex], result->position.z + cube_normals[2 + normalIndex]};
+				struct Chunk* neighbour = findChunk(world, neighbourPos);
+				if(neighbour) neighbour->isMeshUpToDate = false;
+			}
+		}
+
+		struct GenerationResult* next = result->next;
+		deinitBlockStorage(&result->blocks);
+		free(result);
+		result = next;
+	}
+}
+
+/*
+ * Meshes are built on a second pool of worker threads from a snapshot of the chunk and its neighbours taken by the
+ * main thread. Finished meshes are pushed onto a lock-free stack and the main thread only uploads them, so a chunk
+ * keeps drawing its old mesh until the new one arrives.
+ */
+struct MeshJob {
+	struct MeshInput* input;
+	const struct ChunkKernels* kernels; // Of the input's chunk size
+	struct Vec3i position;
+	unsigned int revision;
+	enum MeshMode mode;
+	struct MeshJob* next;
+};
+
+struct MeshResult {
+	struct Vec3i position;
+	unsigned int revision;
+	unsigned int faceOffsets[7]; // Quads are grouped by face direction, see sortQuadsByFace
+	unsigned char faceConnections[6];
+	struct MeshResult* next;
+	GLuint vertices[]; // 2 per vertex
+};
+
+struct Mesher {
+	pthread_t threads[BGL_MaxWorkerThreads];
+	unsigned int threadCount;
+	pthread_mutex_t mutex;
+	pthread_cond_t jobAvailable;
+	struct MeshJob* jobs; // Oldest first
+	struct MeshJob* lastJob;
+	_Atomic(struct MeshResult*) results; // Pushed by the workers, emptied at once by the main thread
+	bool shutdown;
+	// Statistics, guarded by mutex
+	unsigned long meshCount, quadTotal;
+	unsigned int peakQuads; // Largest single mesh
+	size_t builderBytes; // Scratch memory held by all threads together
+};
+
+void pushMeshResult(struct Mesher* mesher, struct MeshResult* result) {
+	struct MeshResult* head = atomic_load_explicit(&mesher->results, memory_order_relaxed);
+	do {
+		result->next = head;
+	} while(!atomic_compare_exchange_weak_explicit(&mesher->results, &head, result, memory_order_release, memory_order_relaxed));
+}
+
+void* mesherWorker(void* arg) {
+	struct Mesher* mesher = arg;
+	struct MeshBuilder mesh; // Results only keep the part that was used
+	initMeshBuilder(&mesh);
+	struct ChunkScratch scratch; // Reserved for the chunk size of the first job
+	initChunkScratch(&scratch);
+	size_t builderBytes = meshBuilderBytes(&mesh);
+
+	pthread_mutex_lock(&mesher->mutex);
+	mesher->builderBytes += builderBytes;
+	for(;;) {
+		while(!mesher->jobs && !mesher->shutdown) {
+			pthread_cond_wait(&mesher->jobAvailable, &mesher->mutex);
+		}
+		if(mesher->shutdown) break;
+
+		struct MeshJob* job = mesher->jobs;
+		mesher->jobs = job->next;
+		pthread_mutex_unlock(&mesher->mutex);
+
+		resetMeshBuilder(&mesh);
+		reserveChunkScratch(&scratch, job->kernels->size);
+		mesh.chunkBits = packChunkPosition(job->position);
+		job->kernels->buildMesh[job->mode](job->input, &mesh);
+
+		struct MeshResult* result = malloc(sizeof(struct MeshResult) + mesh.verticesSize * sizeof(GLuint));
+		result->position = job->position;
+		result->revision = job->revision;
+		sortQuadsByFace(&mesh, result->vertices, result->faceOffsets);
+		job->kernels->computeFaceConnections(job->input, result->faceConnections, &scratch);
+		free(job->input);
+		free(job);
+		pushMeshResult(mesher, result);
+
+		unsigned int quads = mesh.quadCount;
+		pthread_mutex_lock(&mesher->mutex);
+		mesher->meshCount++;
+		mesher->quadTotal += quads;
+		if(quads > mesher->peakQuads) mesher->peakQuads = quads;
+		mesher->builderBytes += meshBuilderBytes(&mesh) + getChunkScratchBytes(&scratch) - builderBytes;
+		builderBytes = meshBuilderBytes(&mesh) + getChunkScratchBytes(&scratch);
+	}
+	pthread_mutex_unlock(&mesher->mutex);
+	deinitChunkScratch(&scratch);
+	deinitMeshBuilder(&mesh);
+	return NULL;
+}
+
+void initMesher(struct Mesher* mesher) {
+	unsigned int threadCount = mesherThreadCount();
+
+	pthread_mutex_init(&mesher->mutex, NULL);
+	pthread_cond_init(&mesher->jobAvailable, NULL);
+	mesher->jobs = NULL;
+	mesher->lastJob = NULL;
+	atomic_init(&mesher->results, NULL);
+	mesher->shutdown = false;
+	mesher->meshCount = 0;
+	mesher->quadTotal = 0;
+	mesher->peakQuads = 0;
+	mesher->builderBytes = 0;
+
+	mesher->threadCount = 0;
+	for(unsigned int i = 0; i < threadCount; i++) {
+		if(pthread_create(&mesher->threads[i], NULL, mesherWorker, mesher) != 0) break;
+		mesher->threadCount++;
+	}
+	assert(mesher->threadCount > 0);
+	printf("Started %u meshing threads\n", mesher->threadCount);
+}
+
+void printMesherStats(struct Mesher* mesher) {
+	pthread_mutex_lock(&mesher->mutex);
+	printf("Meshes built: %lu, average %.1f quads, peak %u quads. Scratch memory: %zu KB over %u threads\n",
+		   mesher->meshCount, mesher->meshCount ? (double)mesher->quadTotal / mesher->meshCount : 0.0, mesher->peakQuads,
+		   mesher->builderBytes / 1024, mesher->threadCount);
+	pthread_mutex_unlock(&mesher->mutex);
+}
+
+void deinitMesher(struct Mesher* mesher) {
+	pthread_mutex_lock(&mesher->mutex);
+	mesher->shutdown = true;
+	pthread_cond_broadcast(&mesher->jobAvailable);
+	pthread_mutex_unlock(&mesher->mutex);
+	for(unsigned int i = 0; i < mesher->threadCount; i++) {
+		pthread_join(mesher->threads[i], NULL);
+	}
+	printMesherStats(mesher);
+
+	while(mesher->jobs) {
+		struct MeshJob* next = mesher->jobs->next;
+		free(mesher->jobs->input);
+		free(mesher->jobs);
+		mesher->jobs = next;
+	}
+	struct MeshResult* result = atomic_exchange(&mesher->results, NULL);
+	while(result) {
+		struct MeshResult* next = result->next;
+		free(result);
+		result = next;
+	}
+	pthread_cond_destroy(&mesher->jobAvailable);
+	pthread_mutex_destroy(&mesher->mutex);
+}
+
+// Snapshot the chunk with its neighbours and hand it to the meshing threads. The chunk must be meshable
+void queueMesh(struct Mesher* mesher, struct World* world, struct Chunk* chunk) {
+	struct MeshJob* job = malloc(sizeof(struct MeshJob));
+	job->input = allocMeshInput(world->chunkSize);
+	job->kernels = world->kernels;
+	world->kernels->copyMeshInput(world, chunk, job->input, &world->scratch);
+	job->position = chunk->position;
+	job->revision = chunk->meshRevision = ++world->meshRevision;
+	job->mode = world->meshMode;
+	job->next = NULL;
+
+	pthread_mutex_lock(&mesher->mutex);
+	if(mesher->jobs) {
+		mesher->lastJob->next = job;
+	} else {
+		mesher->jobs = job;
+	}
+	mesher->lastJob = job;
+	pthread_cond_signal(&mesher->jobAvailable);
+	pthread_mutex_unlock(&mesher->mutex);
+}
+
+// Upload the meshes finished since the last call. Only touches GL on the calling thread and never blocks
+void uploadFinishedMeshes(struct Mesher* mesher, struct World* world) {
+	struct MeshResult* result = atomic_exchange_explicit(&mesher->results, NULL, memory_order_acquire);
+	while(result) {
+		struct Chunk* chunk = findChunk(world, result->position);
+		// Drop meshes superseded by a newer job, or built for a chunk that has been unloaded
+		if(chunk && result->revision == chunk->meshRevision) {
+			uploadMesh(world, chunk, result->vertices, result->faceOffsets);
+			memcpy(chunk->faceConnections, result->faceConnections, sizeof(chunk->faceConnections));
+		}
+
+		struct MeshResult* next = result->next;
+		free(result);
+		result = next;
+	}
+	trimChunkCache(world); // In case a cached chunk got a larger mesh
+}
+
+void toggleFullscreen(GLFWwindow* window) {
+	if(glfwGetWindowMonitor(window)) {
+		glfwSetWindowMonitor(window, NULL, 320, 240, 640, 480, 0);
+	} else {
+		GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+		const GLFWvidmode* mode = glfwGetVideoMode(monitor);
+		glfwSetWindowMonitor(window, monitor, 0, 0, mode->width, mode->height, mode->refreshRate);
+	}
+}
+
+void toggleCursor(GLFWwindow* window) {
+	if(glfwGetInputMode(window, GLFW_CURSOR) == GLFW_CURSOR_NORMAL)
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	else
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+}
+
+static void error_callback(int error, const char* description) {
+	fprintf(stderr, "Error: %s\n", description);
+}
+
+void setMeshMode(struct World* world, enum MeshMode mode) {
+	world->meshMode = mode;
+	for(unsigned int i = 0; i < world->chunks.capacity; i++) {
+		if(world->chunks.entries[i].chunk) world->chunks.entries[i].chunk->isMeshUpToDate = false;
+	}
+	printf("Mesher: %s\n", meshModeNames[mode]);
+}
+
+static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+	printf("Key press: %i\n",key);
+	if (key == GLFW_KEY_Q && action == GLFW_PRESS)
+		glfwSetWindowShouldClose(window, GLFW_TRUE);
+
+	if (key == GLFW_KEY_F && action == GLFW_PRESS)
 		toggleFullscreen(window);
 
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		toggleCursor(window);
+
+	struct World* world = glfwGetWindowUserPointer(window);
+	if (key == GLFW_KEY_M && action == GLFW_PRESS && world)
+		setMeshMode(world, (world->meshMode + 1) % BGL_MeshModeCount);
+
+	if (key == GLFW_KEY_V && action == GLFW_PRESS && world) {
+		world->viewController.isEnabled = !world->viewController.isEnabled;
+		printf("Adaptive view distance %s\n", world->viewController.isEnabled ? "enabled" : "disabled");
+	}
+
+	if ((action == GLFW_PRESS || action == GLFW_REPEAT) && world) {
+		struct Vec3i radius = world->viewRadius;
+		if (key == GLFW_KEY_LEFT_BRACKET) radius.x--;
+		if (key == GLFW_KEY_RIGHT_BRACKET) radius.x++;
+		if (key == GLFW_KEY_MINUS) radius.y--;
+		if (key == GLFW_KEY_EQUAL) radius.y++;
+		if (memcmp(&radius, &world->viewRadius, sizeof(struct Vec3i)) != 0) setViewRadius(world, radius.x, radius.y);
+	}
+}
+
+/*
+ * Per frame counters summed over BGL_StatsInterval and printed as a single line, so the console stays readable at a
+ * few hundred frames per second
+ */
+#define BGL_StatsInterval	1.0 // Seconds
+
+struct FrameStats {
+	double time; // Of the frames counted so far
+	unsigned int frames;
+	unsigned long drawnChunks, culledChunks, occludedChunks;
+	unsigned long drawnQuads, directionCulledQuads;
+	unsigned long uploads;
+	size_t uploadBytes;
+	double startStall; // Upload ring totalStall when counting started
+};
+
+void resetFrameStats(struct FrameStats* stats, const struct World* world) {
+	memset(stats, 0, sizeof(struct FrameStats));
+	stats->startStall = world->uploads.totalStall;
+}
+
+// Call after the chunk draws are added and before drawChunkList() clears its counters
+void countFrameStats(struct FrameStats* stats, const struct World* world, double frameTime, unsigned int drawnChunks,
+					 unsigned int culledChunks, unsigned int occludedChunks) {
+	stats->time += frameTime;
+	stats->frames++;
+	stats->drawnChunks += drawnChunks;
+	stats->culledChunks += culledChunks;
+	stats->occludedChunks += occludedChunks;
+	stats->drawnQuads += world->drawList.drawnQuads;
+	stats->directionCulledQuads += world->drawList.directionCulledQuads;
+	stats->uploads += world->uploads.frameUploads;
+	stats->uploadBytes += world->uploads.frameBytes;
+}
+
+// Prints the averages once BGL_StatsInterval has passed and starts counting again. Call after endUploadFrame()
+void printFrameStats(struct FrameStats* stats, const struct World* world) {
+	if(stats->time < BGL_StatsInterval || stats->frames == 0) return;
+	double frames = stats->frames;
+	printf("%u frames: %.0f chunks drawn, %.0f frustum culled, %.0f occlusion culled, %.0f quads drawn, %.0f direction "
+		   "culled, %.1f mesh uploads of %.0f KB, %.3f ms upload stall per frame. Mesh quads: %lu (%s). Chunk cache: %u "
+		   "chunks, %zu of %zu MB, %lu hits, %lu evictions\n", stats->frames, stats->drawnChunks / frames,
+		   stats->culledChunks / frames, stats->occludedChunks / frames, stats->drawnQuads / frames,
+		   stats->directionCulledQuads / frames, stats->uploads / frames, stats->uploadBytes / frames / 1024,
+		   (world->uploads.totalStall - stats->startStall) / frames * 1000, world->meshQuads, meshModeNames[world->meshMode],
+		   world->cache.count, world->cache.bytes >> 20, world->cache.budget >> 20, world->cache.hits, world->cache.evictions);
+	resetFrameStats(stats, world);
 }
 
-void initMessage() {
+void initMessage(unsigned int chunkSize, double targetFrameTime, size_t cacheBudget, bool cacheMeshes) {
 	printf("Welcome to BlockGL!\n"
 				"\n"
 				"Controls:\n"
@@ -663,12 +3549,19 @@ void initMessage() {
 				" - Use Q to quit the application.\n"
 				" - Use F to toggle fullscreen.\n"
 				" - Use Esc to toggle cursor mode.\n"
+				" - Use M to cycle through the naive, greedy and binary meshers.\n"
+				" - Use [ and ] to change the horizontal view radius, - and = for the vertical one.\n"
+				" - Use V to toggle the adaptive view distance.\n"
+				" - Left click breaks the block in the center of the view, right click places stone.\n"
 				"\n"
 				"Properties:\n"
 				);
-	printf(" - Chunk size: %i\n", BGL_ChunkSize);
-	printf(" - Loading radius: %i\n", BGL_LoadRadius);
-	printf(" - Max faces per chunk: %i\n", BGL_MaxFaces);
+	printf(" - Chunk size: %u\n", chunkSize);
+	printf(" - Block layout: %s\n", BGL_LayoutName);
+	printf(" - Default loading radius: %i\n", defaultLoadRadius(chunkSize));
+	printf(" - Frame time target: %.1f ms\n", targetFrameTime * 1000);
+	printf(" - Chunk cache budget: %zu MB%s\n", cacheBudget >> 20, cacheMeshes ? " with meshes" : "");
+	printf(" - Max faces per chunk: %u\n", BGL_MaxFaces(chunkSize));
 	printf("\n");
 }
 
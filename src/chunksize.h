@@ -0,0 +1,594 @@
+/*
+ * Chunk code specialized for one chunk size. blockgl.h includes this file once per supported size with BGL_ChunkSize
+ * defined as that size, and BGL_Sized() appends the size to every name defined here. Loop bounds, strides and scratch
+ * arrays are constants, so the compiler can unroll and vectorize the inner loops, and the binary mesher gets the
+ * narrowest integer that holds a padded column. A World picks one set through struct ChunkKernels when it is created.
+ */
+#ifndef BGL_ChunkSize
+#error "Define BGL_ChunkSize before including chunksize.h"
+#endif
+
+#define BGL_Sized(name) BGL_Concat2(name, BGL_ChunkSize)
+#define BGL_ChunkVolume (BGL_ChunkSize * BGL_ChunkSize * BGL_ChunkSize)
+#define BGL_PaddedSize (BGL_ChunkSize + 2)
+
+// Terrain noise for every (x, z) column of a chunk. Only depends on the horizontal chunk position
+void BGL_Sized(generateHeightmap)(struct Heightmap* map, int chunkX, int chunkZ) {
+	float (*heights)[BGL_ChunkSize] = (float (*)[BGL_ChunkSize]) map->heights;
+	float x1 = BGL_ChunkSize * chunkX;
+	float z1 = BGL_ChunkSize * chunkZ;
+
+	// Evaluate the noise for all columns in one batch so it runs on SIMD lanes
+	float noiseX[BGL_ChunkSize * BGL_ChunkSize], noiseY[BGL_ChunkSize * BGL_ChunkSize], noiseZ[BGL_ChunkSize * BGL_ChunkSize];
+	for(int x = 0; x < BGL_ChunkSize; x++) {
+		for(int z = 0; z < BGL_ChunkSize; z++) {
+			noiseX[x * BGL_ChunkSize + z] = (x1 + x) / 100.f;
+			noiseY[x * BGL_ChunkSize + z] = 0;
+			noiseZ[x * BGL_ChunkSize + z] = (z1 + z) / 100.f;
+		}
+	}
+	turbulenceNoiseBatch(map->heights, noiseX, noiseY, noiseZ, BGL_ChunkSize * BGL_ChunkSize, 1.3f, 0.8f, 6);
+
+	map->minHeight = heights[0][0];
+	map->maxHeight = heights[0][0];
+	for(int x = 0; x < BGL_ChunkSize; x++) {
+		for(int z = 0; z < BGL_ChunkSize; z++) {
+			if(heights[x][z] < map->minHeight) map->minHeight = heights[x][z];
+			if(heights[x][z] > map->maxHeight) map->maxHeight = heights[x][z];
+		}
+	}
+}
+
+/*
+ * Returns the block id filling the whole chunk at height chunkY, or -1 if the chunk holds a mix of blocks.
+ * Mirrors the rules in generatePerlinTerrain(). The depth below the surface only grows with the noise value and shrinks
+ * with y, so checking the extreme heights against the bottom and top layer covers every column.
+ */
+int BGL_Sized(uniformTerrainId)(const struct Heightmap* map, int chunkY) {
+	int bottom = BGL_ChunkSize * chunkY;
+	int top = bottom + BGL_ChunkSize - 1;
+	int maxDisToTop = map->maxHeight * 40 - bottom - 20;
+	int minDisToTop = map->minHeight * 40 - top - 20;
+
+	if(maxDisToTop <= 0) {
+		if(bottom > 0) return 0; // Air
+		if(top <= 0) return 5; // Water
+	}
+	if(minDisToTop > 2) return 1; // Stone
+	return -1;
+}
+
+// Blocks are written in storage order, see BGL_ForEachBlock
+void BGL_Sized(generateCosineTerrain)(struct Block blocks[BGL_ChunkVolume], const struct Vec3i pos) {
+	//Previous memory should be cleared
+	float x1 = BGL_ChunkSize * pos.x;
+	float y1 = BGL_ChunkSize * pos.y;
+	float z1 = BGL_ChunkSize * pos.z;
+	BGL_ForEachBlock(x, y, z) {
+		float val = cosf((x + x1)/20.f) * cosf((z + z1)/20.f) * 10 + 20;
+		unsigned short id;
+		if(val > y + y1) {
+			id = 1;
+		}
+		else {
+			id = 0;
+		}
+		blocks[BGL_BlockIndex(x, y, z)].id = id;
+	}
+}
+
+// Blocks are written in storage order, see BGL_ForEachBlock
+void BGL_Sized(generatePerlinTerrain)(struct Block blocks[BGL_ChunkVolume], const struct Vec3i pos, const struct Heightmap* map) {
+	//Previous memory should be cleared
+	const float (*heights)[BGL_ChunkSize] = (const float (*)[BGL_ChunkSize]) map->heights;
+	float y1 = BGL_ChunkSize * pos.y;
+	BGL_ForEachBlock(x, y, z) {
+		float val = heights[x][z];
+		int y2 = y1 + y;
+		unsigned short id = 0;
+		int disToTop = val * 40 - y2 - 20;
+		if (disToTop <= 0) {
+			if(y2 <= 0) {
+				id = 5;
+			}
+			else {
+				id = 0;
+			}
+		} else if (disToTop <= 1) {
+			if(y2 <= 2) {
+				id = 4;
+			}
+			else {
+				id = 2;
+			}
+		} else if (disToTop <= 2) {
+			if(y2 <= 2) {
+				id = 4;
+			}
+			else {
+				id = 3;
+			}
+		} else {
+			id = 1;
+		}
+		blocks[BGL_BlockIndex(x, y, z)].id = id;
+	}
+}
+
+void BGL_Sized(generateChunkBlocks)(const struct Heightmap* map, const struct Vec3i position, struct BlockStorage* blocks, struct ChunkScratch* scratch) {
+	int uniformId = BGL_Sized(uniformTerrainId)(map, position.y);
+	if(uniformId >= 0) {
+		initBlockStorage(blocks, BGL_ChunkSize, uniformId);
+	} else {
+		assert(scratch->size == BGL_ChunkSize);
+		BGL_Sized(generatePerlinTerrain)(scratch->blocks, position, map);
+		blocks->palette = NULL;
+		blocks->words = NULL;
+		packBlockStorage(blocks, BGL_ChunkSize, scratch->blocks);
+	}
+}
+
+// Decode the blocks in storage order, then place them in the padded buffer, which is always indexed [x][y][z]
+void BGL_Sized(copyChunkBlocks)(const struct BlockStorage* blocks, struct MeshInput* input, struct ChunkScratch* scratch) {
+	unsigned short (*ids)[BGL_PaddedSize][BGL_PaddedSize] = (void*) input->ids;
+	input->isUniform = blocks->bits == 0;
+	input->uniformId = blocks->palette[0];
+#if BGL_BlockLayout == BGL_LayoutXYZ
+	for(int x = 0; x < BGL_ChunkSize; x++) {
+		for(int y = 0; y < BGL_ChunkSize; y++) {
+			unpackBlockRow(blocks, BGL_BlockIndex(x, y, 0), BGL_ChunkSize, &ids[x + 1][y + 1][1]);
+		}
+	}
+#else
+	assert(scratch->size == BGL_ChunkSize);
+	unsigned short* unpacked = scratch->ids;
+	unpackBlockRow(blocks, 0, BGL_ChunkVolume, unpacked);
+	BGL_ForEachBlock(x, y, z) {
+		ids[x + 1][y + 1][z + 1] = unpacked[BGL_BlockIndex(x, y, z)];
+	}
+#endif
+}
+
+void BGL_Sized(copyMeshInput)(struct World* world, const struct Chunk* chunk, struct MeshInput* input, struct ChunkScratch* scratch) {
+	unsigned short (*ids)[BGL_PaddedSize][BGL_PaddedSize] = (void*) input->ids;
+	memset(ids, 0, BGL_PaddedSize * BGL_PaddedSize * BGL_PaddedSize * sizeof(unsigned short));
+	BGL_Sized(copyChunkBlocks)(&chunk->blocks, input, scratch);
+
+	for(int i = 0; i < 6; i++) {
+		int normalIndex = i * 3;
+		int axis = cube_normals[0 + normalIndex] != 0 ? 0 : (cube_normals[1 + normalIndex] != 0 ? 1 : 2);
+		int step = cube_normals[axis + normalIndex] > 0 ? 1 : -1;
+		struct Vec3i neighbourPos = { chunk->position.x + cube_normals[0 + normalIndex], chunk->position.y + cube_normals[1 + normalIndex], chunk->position.z + cube_normals[2 + normalIndex]};
+		const struct Chunk* neighbour = findChunk(world, neighbourPos);
+
+		// The layer of the neighbour touching this chunk, and where it goes in the padded buffer
+		int source = step > 0 ? 0 : BGL_ChunkSize - 1;
+		int target = step > 0 ? BGL_ChunkSize + 1 : 0;
+		for(int a = 0; a < BGL_ChunkSize; a++) {
+			for(int b = 0; b < BGL_ChunkSize; b++) {
+				int from[3], to[3];
+				from[axis] = source;
+				to[axis] = target;
+				from[(axis + 1) % 3] = a;
+				to[(axis + 1) % 3] = a + 1;
+				from[(axis + 2) % 3] = b;
+				to[(axis + 2) % 3] = b + 1;
+				ids[to[0]][to[1]][to[2]] = getStorageId(&neighbour->blocks, BGL_BlockIndex(from[0], from[1], from[2]));
+			}
+		}
+	}
+}
+
+void BGL_Sized(generateNaiveMesh)(const struct MeshInput* input, struct MeshBuilder* mesh) {
+	const unsigned short (*ids)[BGL_PaddedSize][BGL_PaddedSize] = (const void*) input->ids;
+	if(input->isUniform) {
+		// Uniform chunk. Faces can only show on the chunk border, so only the outer layer facing outwards is checked
+		const unsigned short id = input->uniformId;
+		for(int i = 0; id > 0 && i < 6; i++) {
+			int normalIndex = i * 3;
+			int axis = cube_normals[0 + normalIndex] != 0 ? 0 : (cube_normals[1 + normalIndex] != 0 ? 1 : 2);
+			int layer = cube_normals[axis + normalIndex] > 0 ? BGL_ChunkSize - 1 : 0;
+			for(int a = 0; a < BGL_ChunkSize; a++) {
+				for(int b = 0; b < BGL_ChunkSize; b++) {
+					int local[3];
+					local[axis] = layer;
+					local[(axis + 1) % 3] = a;
+					local[(axis + 2) % 3] = b;
+					unsigned short neighbour = ids[local[0] + 1 + (int)cube_normals[0 + normalIndex]][local[1] + 1 + (int)cube_normals[1 + normalIndex]][local[2] + 1 + (int)cube_normals[2 + normalIndex]];
+					if (neighbour == 0) {
+						addFace(mesh, local[0], local[1], local[2], id, i);
+					}
+				}
+			}
+		}
+		return;
+	}
+
+	for(int x = 0; x < BGL_ChunkSize; x++) {
+		for (int y = 0; y < BGL_ChunkSize; y++) {
+			for (int z = 0; z < BGL_ChunkSize; z++) {
+				const unsigned short id = ids[x + 1][y + 1][z + 1];
+				if(id > 0) {
+					for(int i = 0; i < 6; i++) {
+						int normalIndex = i * 3;
+						unsigned short neighbour = ids[x + 1 + (int)cube_normals[0 + normalIndex]][y + 1 + (int)cube_normals[1 + normalIndex]][z + 1 + (int)cube_normals[2 + normalIndex]];
+						if (neighbour == 0) {
+							addFace(mesh, x, y, z, id, i);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+/*
+ * Greedy meshing. For each direction the chunk is cut into slices along the normal. Each slice gets a mask of the
+ * visible faces and their texture layer, and the mask is covered with as few rectangles as possible: a run of equal
+ * faces along u is grown along v for as long as the whole run matches.
+ */
+void BGL_Sized(generateGreedyMesh)(const struct MeshInput* input, struct MeshBuilder* mesh) {
+	if(input->isUniform && input->uniformId == 0) return;
+	const unsigned short (*ids)[BGL_PaddedSize][BGL_PaddedSize] = (const void*) input->ids;
+
+	GLuint mask[BGL_ChunkSize][BGL_ChunkSize]; // [v][u], texture layer + 1 of the visible face or 0
+	for(int i = 0; i < 6; i++) {
+		int normalIndex = i * 3;
+		int axis = cube_normals[0 + normalIndex] != 0 ? 0 : (cube_normals[1 + normalIndex] != 0 ? 1 : 2);
+		int uAxis = face_uAxis[i];
+		int vAxis = face_vAxis[i];
+		int step = cube_normals[axis + normalIndex] > 0 ? 1 : -1;
+
+		// Only the outward facing border of a uniform chunk can be visible
+		int first = 0, last = BGL_ChunkSize - 1;
+		if(input->isUniform) {
+			first = last = step > 0 ? BGL_ChunkSize - 1 : 0;
+		}
+
+		for(int slice = first; slice <= last; slice++) {
+			bool isEmpty = true;
+			for(int v = 0; v < BGL_ChunkSize; v++) {
+				for(int u = 0; u < BGL_ChunkSize; u++) {
+					int local[3];
+					local[axis] = slice + 1;
+					local[uAxis] = u + 1;
+					local[vAxis] = v + 1;
+					unsigned short id = ids[local[0]][local[1]][local[2]];
+					mask[v][u] = 0;
+					if(id > 0) {
+						local[axis] += step;
+						if(ids[local[0]][local[1]][local[2]] == 0) {
+							mask[v][u] = block_textureIds[id][i] + 1;
+							isEmpty = false;
+						}
+					}
+				}
+			}
+			if(isEmpty) continue;
+
+			for(int v = 0; v < BGL_ChunkSize; v++) {
+				for(int u = 0; u < BGL_ChunkSize; u++) {
+					GLuint key = mask[v][u];
+					if(key == 0) continue;
+
+					int width = 1;
+					while(u + width < BGL_ChunkSize && mask[v][u + width] == key) width++;
+
+					int height = 1;
+					for(; v + height < BGL_ChunkSize; height++) {
+						bool rowMatches = true;
+						for(int k = 0; k < width; k++) {
+							if(mask[v + height][u + k] != key) {
+								rowMatches = false;
+								break;
+							}
+						}
+						if(!rowMatches) break;
+					}
+
+					for(int h = 0; h < height; h++) {
+						for(int k = 0; k < width; k++) {
+							mask[v + h][u + k] = 0;
+						}
+					}
+
+					int lo[3], hi[3];
+					lo[axis] = hi[axis] = slice;
+					lo[uAxis] = u;
+					hi[uAxis] = u + width - 1;
+					lo[vAxis] = v;
+					hi[vAxis] = v + height - 1;
+					addQuad(mesh, lo, hi, key - 1, i);
+				}
+			}
+		}
+	}
+}
+
+// One bit per block of a padded column, in the narrowest integer that holds it
+#if BGL_PaddedSize <= 32
+typedef uint32_t BGL_Sized(BinaryRow);
+#define BGL_LowestBit(row) __builtin_ctz(row)
+#elif BGL_PaddedSize <= 64
+typedef uint64_t BGL_Sized(BinaryRow);
+#define BGL_LowestBit(row) __builtin_ctzll(row)
+#else
+typedef unsigned __int128 BGL_Sized(BinaryRow);
+#define BGL_LowestBit(row) ((uint64_t)(row) ? __builtin_ctzll((uint64_t)(row)) : 64 + __builtin_ctzll((uint64_t)((row) >> 64)))
+#endif
+
+/*
+ * Binary meshing. Occupancy is stored as one bit row per (x, y), with bit z set for solid blocks, including the halo.
+ * A face is visible where a block is solid and its neighbour isn't, so a whole row of faces is found at once with an
+ * AND-NOT: against the neighbouring row for the x and y directions, and against the row shifted by one for z. Only the
+ * set bits of the result are visited.
+ */
+void BGL_Sized(generateBinaryMesh)(const struct MeshInput* input, struct MeshBuilder* mesh) {
+	typedef BGL_Sized(BinaryRow) Row;
+	if(input->isUniform && input->uniformId == 0) return;
+	const unsigned short (*ids)[BGL_PaddedSize][BGL_PaddedSize] = (const void*) input->ids;
+
+	Row rows[BGL_PaddedSize][BGL_PaddedSize];
+	for(int x = 0; x < BGL_PaddedSize; x++) {
+		for(int y = 0; y < BGL_PaddedSize; y++) {
+			Row row = 0;
+			for(int z = 0; z < BGL_PaddedSize; z++) {
+				row |= (Row)(ids[x][y][z] != 0) << z;
+			}
+			rows[x][y] = row;
+		}
+	}
+
+	const Row interior = (((Row)1 << BGL_ChunkSize) - 1) << 1; // Drops the halo bits
+	for(int x = 1; x <= BGL_ChunkSize; x++) {
+		for(int y = 1; y <= BGL_ChunkSize; y++) {
+			Row row = rows[x][y];
+			if(!(row & interior)) continue;
+
+			// Same order as cube_normals: +X, -X, +Y, -Y, +Z, -Z
+			Row visible[6] = {
+					row & ~rows[x + 1][y],
+					row & ~rows[x - 1][y],
+					row & ~rows[x][y + 1],
+					row & ~rows[x][y - 1],
+					row & ~(row >> 1),
+					row & ~(row << 1),
+			};
+			for(int i = 0; i < 6; i++) {
+				Row faces = visible[i] & interior;
+				while(faces) {
+					int z = BGL_LowestBit(faces);
+					faces &= faces - 1;
+					addFace(mesh, x - 1, y - 1, z - 1, ids[x][y][z], i);
+				}
+			}
+		}
+	}
+}
+
+/*
+ * Which faces of the chunk can see each other through air, found by flood filling every air pocket and noting the
+ * chunk faces it touches. The visibility search only passes through a chunk between connected faces.
+ */
+void BGL_Sized(computeFaceConnections)(const struct MeshInput* input, unsigned char connections[6], struct ChunkScratch* scratch) {
+	if(input->isUniform) {
+		memset(connections, input->uniformId == 0 ? 0x3f : 0, 6);
+		return;
+	}
+	memset(connections, 0, 6);
+	const unsigned short (*ids)[BGL_PaddedSize][BGL_PaddedSize] = (const void*) input->ids;
+
+	assert(scratch->size == BGL_ChunkSize);
+	bool (*visited)[BGL_ChunkSize][BGL_ChunkSize] = (void*) scratch->visited;
+	uint32_t* stack = scratch->stack;
+	memset(visited, 0, BGL_ChunkVolume * sizeof(bool));
+	for(int start = 0; start < BGL_ChunkVolume; start++) {
+		int sx = start / (BGL_ChunkSize * BGL_ChunkSize), sy = start / BGL_ChunkSize % BGL_ChunkSize, sz = start % BGL_ChunkSize;
+		if(visited[sx][sy][sz] || ids[sx + 1][sy + 1][sz + 1] != 0) continue;
+
+		unsigned char faces = 0;
+		int stackSize = 0;
+		visited[sx][sy][sz] = true;
+		stack[stackSize++] = start;
+		while(stackSize > 0) {
+			int index = stack[--stackSize];
+			int pos[3] = {index / (BGL_ChunkSize * BGL_ChunkSize), index / BGL_ChunkSize % BGL_ChunkSize, index % BGL_ChunkSize};
+			for(int i = 0; i < 6; i++) {
+				int normalIndex = i * 3;
+				int next[3] = {pos[0] + (int)cube_normals[0 + normalIndex], pos[1] + (int)cube_normals[1 + normalIndex], pos[2] + (int)cube_normals[2 + normalIndex]};
+				if(next[i / 2] < 0 || next[i / 2] >= BGL_ChunkSize) {
+					faces |= 1 << i;
+					continue;
+				}
+				if(visited[next[0]][next[1]][next[2]] || ids[next[0] + 1][next[1] + 1][next[2] + 1] != 0) continue;
+				visited[next[0]][next[1]][next[2]] = true;
+				stack[stackSize++] = (next[0] * BGL_ChunkSize + next[1]) * BGL_ChunkSize + next[2];
+			}
+		}
+
+		for(int i = 0; i < 6; i++) {
+			if(faces & (1 << i)) connections[i] |= faces;
+		}
+	}
+}
+
+// Air blocks around the block at (x, y, z) of a chunk, not looking past its border
+unsigned int BGL_Sized(countOpenFaces)(const struct Block* chunk, int x, int y, int z) {
+	return (x + 1 < BGL_ChunkSize && chunk[BGL_BlockIndex(x + 1, y, z)].id == 0) + (x > 0 && chunk[BGL_BlockIndex(x - 1, y, z)].id == 0) +
+		   (y + 1 < BGL_ChunkSize && chunk[BGL_BlockIndex(x, y + 1, z)].id == 0) + (y > 0 && chunk[BGL_BlockIndex(x, y - 1, z)].id == 0) +
+		   (z + 1 < BGL_ChunkSize && chunk[BGL_BlockIndex(x, y, z + 1)].id == 0) + (z > 0 && chunk[BGL_BlockIndex(x, y, z - 1)].id == 0);
+}
+
+// See benchmarkBlockLayout()
+void BGL_Sized(benchmarkBlockLayout)() {
+	unsigned int chunkCount = BGL_BenchmarkBlocks / BGL_ChunkVolume;
+	struct Block* blocks = malloc((size_t) BGL_BenchmarkBlocks * sizeof(struct Block));
+	struct BlockStorage* storages = malloc(chunkCount * sizeof(struct BlockStorage));
+	struct Heightmap* maps = malloc(chunkCount * sizeof(struct Heightmap));
+	struct MeshInput* input = allocMeshInput(BGL_ChunkSize);
+	struct ChunkScratch scratch;
+	initChunkScratch(&scratch);
+	reserveChunkScratch(&scratch, BGL_ChunkSize);
+	// Columns of 4 chunks around the surface, so most of them hold a mix of blocks
+	for(unsigned int i = 0; i < chunkCount; i++) {
+		BGL_Sized(generateHeightmap)(&maps[i], i / 4 % 32, i / 128);
+	}
+	double volume = (double) BGL_BenchmarkBlocks;
+	unsigned long checksum = 0;
+
+	double start = getBenchmarkTime();
+	for(unsigned int i = 0; i < chunkCount; i++) {
+		struct Vec3i position = {i / 4 % 32, (int)(i % 4) - 2, i / 128};
+		BGL_Sized(generatePerlinTerrain)(&blocks[(size_t) i * BGL_ChunkVolume], position, &maps[i]);
+	}
+	double generateTime = getBenchmarkTime() - start;
+
+	// The heightmap noise of a chunk through every kernel the CPU runs, the scalar one being stb_perlin per column
+	double noiseTimes[BGL_NoiseKernelCount];
+	for(enum NoiseKernel kernel = BGL_NoiseScalar; kernel < BGL_NoiseKernelCount; kernel++) {
+		noiseTimes[kernel] = -1;
+		if(!hasNoiseKernel(kernel)) continue;
+		float noiseX[BGL_ChunkSize * BGL_ChunkSize], noiseY[BGL_ChunkSize * BGL_ChunkSize] = {0};
+		float noiseZ[BGL_ChunkSize * BGL_ChunkSize], heights[BGL_ChunkSize * BGL_ChunkSize];
+		start = getBenchmarkTime();
+		for(unsigned int i = 0; i < chunkCount; i++) {
+			for(int x = 0; x < BGL_ChunkSize; x++) {
+				for(int z = 0; z < BGL_ChunkSize; z++) {
+					noiseX[x * BGL_ChunkSize + z] = (BGL_ChunkSize * (float)(i % 64) + x) / 100.f;
+					noiseZ[x * BGL_ChunkSize + z] = (BGL_ChunkSize * (float)(i / 64) + z) / 100.f;
+				}
+			}
+			turbulenceNoiseKernel(kernel, heights, noiseX, noiseY, noiseZ, BGL_ChunkSize * BGL_ChunkSize, 1.3f, 0.8f, 6);
+			checksum += heights[i % (BGL_ChunkSize * BGL_ChunkSize)] > 1;
+		}
+		noiseTimes[kernel] = getBenchmarkTime() - start;
+	}
+
+	start = getBenchmarkTime();
+	for(unsigned int i = 0; i < chunkCount; i++) {
+		storages[i].palette = NULL;
+		storages[i].words = NULL;
+		packBlockStorage(&storages[i], BGL_ChunkSize, &blocks[(size_t) i * BGL_ChunkVolume]);
+	}
+	double packTime = getBenchmarkTime() - start;
+
+	const unsigned short (*ids)[BGL_PaddedSize][BGL_PaddedSize] = (const void*) input->ids;
+	start = getBenchmarkTime();
+	for(unsigned int i = 0; i < chunkCount; i++) {
+		BGL_Sized(copyChunkBlocks)(&storages[i], input, &scratch);
+		checksum += ids[1 + i % BGL_ChunkSize][1][1];
+	}
+	double unpackTime = getBenchmarkTime() - start;
+
+	// The access pattern of the naive mesher
+	start = getBenchmarkTime();
+	for(unsigned int i = 0; i < chunkCount; i++) {
+		const struct Block* chunk = &blocks[(size_t) i * BGL_ChunkVolume];
+		BGL_ForEachBlock(x, y, z) {
+			if(chunk[BGL_BlockIndex(x, y, z)].id != 0) checksum += BGL_Sized(countOpenFaces)(chunk, x, y, z);
+		}
+	}
+	double neighbourTime = getBenchmarkTime() - start;
+
+	uint32_t random = 1;
+	start = getBenchmarkTime();
+	for(unsigned int i = 0; i < BGL_BenchmarkLookups; i++) {
+		random = random * 1664525u + 1013904223u;
+		const struct Block* chunk = &blocks[(size_t)(random >> 8) % chunkCount * BGL_ChunkVolume];
+		random = random * 1664525u + 1013904223u;
+		unsigned int position = random >> 8;
+		checksum += BGL_Sized(countOpenFaces)(chunk, position % BGL_ChunkSize, position / BGL_ChunkSize % BGL_ChunkSize,
+											  position / (BGL_ChunkSize * BGL_ChunkSize) % BGL_ChunkSize);
+	}
+	double randomTime = getBenchmarkTime() - start;
+
+	// Larger chunks cost more to remesh after an edit, but leave fewer draws per frame
+	struct MeshBuilder mesh;
+	initMeshBuilder(&mesh);
+	unsigned long quads = 0;
+	start = getBenchmarkTime();
+	for(unsigned int i = 0; i < chunkCount; i++) {
+		BGL_Sized(copyChunkBlocks)(&storages[i], input, &scratch);
+		resetMeshBuilder(&mesh);
+		BGL_Sized(generateGreedyMesh)(input, &mesh);
+		quads += mesh.quadCount;
+	}
+	double meshTime = getBenchmarkTime() - start;
+
+	// Block access through the packed storage, the path of edits and lookups outside the kernels
+	start = getBenchmarkTime();
+	for(unsigned int i = 0; i < chunkCount; i++) {
+		BGL_ForEachBlock(x, y, z) {
+			checksum += getStorageId(&storages[i], BGL_BlockIndex(x, y, z));
+		}
+	}
+	double getTime = getBenchmarkTime() - start;
+
+	// Mirrored in y, so most blocks change but the palettes stay the same
+	start = getBenchmarkTime();
+	for(unsigned int i = 0; i < chunkCount; i++) {
+		const struct Block* chunk = &blocks[(size_t) i * BGL_ChunkVolume];
+		BGL_ForEachBlock(x, y, z) {
+			setStorageId(&storages[i], BGL_BlockIndex(x, y, z), chunk[BGL_BlockIndex(x, BGL_ChunkSize - 1 - y, z)].id);
+		}
+	}
+	double setTime = getBenchmarkTime() - start;
+
+	start = getBenchmarkTime();
+	for(unsigned int i = 0; i < BGL_BenchmarkLookups; i++) {
+		random = random * 1664525u + 1013904223u;
+		struct BlockStorage* storage = &storages[(random >> 8) % chunkCount];
+		random = random * 1664525u + 1013904223u;
+		unsigned int position = random >> 8;
+		unsigned int x = position % BGL_ChunkSize, y = position / BGL_ChunkSize % BGL_ChunkSize,
+					 z = position / (BGL_ChunkSize * BGL_ChunkSize) % BGL_ChunkSize;
+		unsigned short id = getStorageId(storage, BGL_BlockIndex(x, y, z));
+		setStorageId(storage, BGL_BlockIndex(x, BGL_ChunkSize - 1 - y, z), id);
+		checksum += id;
+	}
+	double randomAccessTime = getBenchmarkTime() - start;
+
+	printf("Block layout %s, chunk size %i, %u chunks (checksum %lu)\n", BGL_LayoutName, BGL_ChunkSize, chunkCount, checksum);
+	printf(" - Generate: %.2f ns per block\n", generateTime / volume * 1e9);
+	for(enum NoiseKernel kernel = BGL_NoiseScalar; kernel < BGL_NoiseKernelCount; kernel++) {
+		if(noiseTimes[kernel] < 0) continue;
+		printf(" - Heightmap noise, %s: %.1f us per chunk, %.1fx scalar\n", noiseKernelNames[kernel],
+			   noiseTimes[kernel] / chunkCount * 1e6, noiseTimes[BGL_NoiseScalar] / noiseTimes[kernel]);
+	}
+	printf(" - Pack: %.2f ns per block\n", packTime / volume * 1e9);
+	printf(" - Unpack to mesh input: %.2f ns per block\n", unpackTime / volume * 1e9);
+	printf(" - Neighbour walk: %.2f ns per block\n", neighbourTime / volume * 1e9);
+	printf(" - Random neighbourhoods: %.2f ns per lookup\n", randomTime / BGL_BenchmarkLookups * 1e9);
+	printf(" - Greedy remesh: %.1f us and %.0f quads per chunk\n", meshTime / chunkCount * 1e6, (double) quads / chunkCount);
+	printf(" - Storage get: %.2f ns per block, set: %.2f ns per block\n", getTime / volume * 1e9, setTime / volume * 1e9);
+	printf(" - Random storage get and set: %.2f ns per pair\n", randomAccessTime / BGL_BenchmarkLookups * 1e9);
+
+	for(unsigned int i = 0; i < chunkCount; i++) {
+		deinitBlockStorage(&storages[i]);
+	}
+	deinitMeshBuilder(&mesh);
+	deinitChunkScratch(&scratch);
+	free(input);
+	free(maps);
+	free(storages);
+	free(blocks);
+}
+
+const struct ChunkKernels BGL_Sized(chunkKernels) = {
+		.size = BGL_ChunkSize,
+		.generateHeightmap = BGL_Sized(generateHeightmap),
+		.generateChunkBlocks = BGL_Sized(generateChunkBlocks),
+		.copyMeshInput = BGL_Sized(copyMeshInput),
+		.buildMesh = {
+				[BGL_MeshNaive] = BGL_Sized(generateNaiveMesh),
+				[BGL_MeshGreedy] = BGL_Sized(generateGreedyMesh),
+				[BGL_MeshBinary] = BGL_Sized(generateBinaryMesh),
+		},
+		.computeFaceConnections = BGL_Sized(computeFaceConnections),
+		.benchmark = BGL_Sized(benchmarkBlockLayout),
+};
+
+#undef BGL_LowestBit
+#undef BGL_PaddedSize
+#undef BGL_ChunkVolume
+#undef BGL_Sized
@@ -5,15 +5,64 @@
 #include <linmath.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <ctype.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
 #include "blockgl.h"
+#include "selfcheck.h"
 
-int main(void) {
-	initMessage();
+int main(int argc, char** argv) {
+	// blockgl --benchmark-layout times the block layout this build was compiled with at every chunk size
+	if(argc > 1 && strcmp(argv[1], "--benchmark-layout") == 0) {
+		benchmarkBlockLayout();
+		return EXIT_SUCCESS;
+	}
+	// blockgl --check runs the headless self checks, see selfcheck.h
+	if(argc > 1 && strcmp(argv[1], "--check") == 0) {
+		return runSelfChecks() ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Optional load radius, frame time target, save directory, chunk cache size, chunk size (16, 32 or 64), whether
+	// cached chunks keep their meshes (1 or 0) and whether generated terrain is cached on disk (1 or 0):
+	// blockgl [horizontal] [vertical] [target ms] [directory] [cache MB] [chunk size] [cache meshes] [terrain cache]
+	unsigned int chunkSize = argc > 6 ? (unsigned int) atoi(argv[6]) : BGL_DefaultChunkSize;
+	if(!getChunkKernels(chunkSize)) {
+		printf("Unsupported chunk size %u, using %u\n", chunkSize, BGL_DefaultChunkSize);
+		chunkSize = BGL_DefaultChunkSize;
+	}
+	int horizontalRadius = argc > 1 ? atoi(argv[1]) : defaultLoadRadius(chunkSize);
+	int verticalRadius = argc > 2 ? atoi(argv[2]) : horizontalRadius;
+	char* end = NULL;
+	double targetFrameTime = argc > 3 ? strtod(argv[3], &end) / 1000 : BGL_TargetFrameTime;
+	if(argc > 3 && (end == argv[3] || *end != '\0' || !(targetFrameTime > 0) || isinf(targetFrameTime))) {
+		printf("Invalid frame time target %s, using %.1f ms\n", argv[3], BGL_TargetFrameTime * 1000);
+		targetFrameTime = BGL_TargetFrameTime;
+	}
+	const char* saveDirectory = argc > 4 ? argv[4] : BGL_SaveDirectory;
+	// Unsigned, so a negative size can't wrap into a huge budget
+	unsigned long cacheMegabytes = argc > 5 ? strtoul(argv[5], &end, 10) : BGL_ChunkCacheBudget >> 20;
+	if(argc > 5 && (!isdigit((unsigned char) argv[5][0]) || *end != '\0' || cacheMegabytes > SIZE_MAX >> 20)) {
+		printf("Invalid chunk cache size %s, using %zu MB\n", argv[5], BGL_ChunkCacheBudget >> 20);
+		cacheMegabytes = BGL_ChunkCacheBudget >> 20;
+	}
+	size_t cacheBudget = (size_t) cacheMegabytes << 20;
+	bool cacheMeshes = argc > 7 ? atoi(argv[7]) != 0 : BGL_ChunkCacheMeshes;
+	bool cacheTerrain = argc > 8 ? atoi(argv[8]) != 0 : BGL_TerrainCache;
+
+	initMessage(chunkSize, targetFrameTime, cacheBudget, cacheMeshes);
 	GLFWwindow* window = initWindow();
 
 	/*
@@ -25,6 +74,8 @@ int main(void) {
 	GLint view_location, projection_location;
 	projection_location = glGetUniformLocation(program, "projection");
 	view_location = glGetUniformLocation(program, "view");
+	GLint cameraChunk_location = glGetUniformLocation(program, "cameraChunk");
+	GLint chunkSize_location = glGetUniformLocation(program, "chunkSize");
 
 	GLint lightPos_location, lightColor_location, fogColor_location;
 	lightPos_location = glGetUniformLocation(program, "lightPos");
@@ -87,7 +138,30 @@ int main(void) {
 	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
 
 	struct World* world = malloc(sizeof(struct World));
-	initWorld(world);
+	initWorld(world, chunkSize, horizontalRadius, verticalRadius);
+	world->viewController.targetFrameTime = targetFrameTime;
+	world->cache.budget = cacheBudget;
+	world->cache.keepsMeshes = cacheMeshes;
+	glfwSetWindowUserPointer(window, world);
+
+	// Creates the save directory
+	struct EditLog* editLog = malloc(sizeof(struct EditLog));
+	initEditLog(editLog, saveDirectory, chunkSize);
+	world->edits = editLog;
+
+	struct RegionStore* store = NULL;
+	if(cacheTerrain) {
+		char terrainDirectory[300];
+		snprintf(terrainDirectory, sizeof(terrainDirectory), "%s/" BGL_TerrainDirectory, saveDirectory);
+		store = malloc(sizeof(struct RegionStore));
+		initRegionStore(store, terrainDirectory, chunkSize);
+	}
+
+	struct Generator* generator = malloc(sizeof(struct Generator));
+	initGenerator(generator, world->kernels, world->loadRadius, store);
+
+	struct Mesher* mesher = malloc(sizeof(struct Mesher));
+	initMesher(mesher);
 
 	struct Camera camera;
 	camera.position[0] = 0;
@@ -97,12 +171,17 @@ int main(void) {
 	camera.rotation[0] = 0;
 	camera.rotation[1] = 0;
 	camera.rotation[2] = 0;
+	camera.isBreaking = false;
+	camera.isPlacing = false;
 
 	double time;
 	initTime(&time);
 	double DT = 0;
+	struct FrameStats stats;
+	resetFrameStats(&stats, world);
 	while (!glfwWindowShouldClose(window)) {
 		DT = getDelta(&time);
+		updateViewDistance(world, DT);
 		handleCameraInput(&camera, window, DT);
 		printf("Delta: %f\n", DT);
 		printf("CamPos: %f, %f, %f. CamDir: %f, %f, %f.\n", camera.position[0], camera.position[1], camera.position[2],
@@ -122,6 +201,12 @@ int main(void) {
 		mat4x4_perspective(proj, 45, ratio, 0.1f, 10000.f);
 
 		getCameraMatrix(&camera, &view);
+		handleBlockInput(&camera, window, world, view);
+
+		mat4x4 viewProjection;
+		mat4x4_mul(viewProjection, proj, view);
+		struct Frustum frustum;
+		extractFrustum(&frustum, viewProjection);
 
 		glUseProgram(program);
 		glUniformMatrix4fv(view_location, 1, GL_FALSE, (const GLfloat*) view);
@@ -134,55 +219,78 @@ int main(void) {
 		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
 		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		// Merged quads rely on the texture repeating
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
 		glEnable(GL_DEPTH_TEST);
 		glEnable(GL_CULL_FACE);
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-		struct Vec3i chp = toChunkPos(camera.position); //Camera chunk position
-		for(int x = chp.x - (int)BGL_LoadRadius; x <= chp.x + (int)BGL_LoadRadius; x++) {
-			for(int y = chp.y - (int)BGL_LoadRadius; y <= chp.y + (int)BGL_LoadRadius; y++) {
-				for(int z = chp.z - (int)BGL_LoadRadius; z <= chp.z + (int)BGL_LoadRadius; z++) {
+		collectGeneratedChunks(generator, world);
+		uploadFinishedMeshes(mesher, world);
+
+		struct Vec3i chp = toChunkPos(camera.position, chunkSize); //Camera chunk position
+		updateLoadVolume(world, chp);
+		struct Vec3i radius = world->loadRadius;
+		setGeneratorCenter(generator, chp, radius);
+		for(int x = chp.x - radius.x; x <= chp.x + radius.x; x++) {
+			for(int y = chp.y - radius.y; y <= chp.y + radius.y; y++) {
+				for(int z = chp.z - radius.z; z <= chp.z + radius.z; z++) {
 					struct Vec3i chunkPos;
 					set(&chunkPos, x, y, z);
-					struct Vec3i memPos = toMemoryPos(chunkPos);
-					struct Chunk* chunk = &world->chunks[memPos.x][memPos.y][memPos.z];
-
-					if(!chunk->isGenerated || memcmp(&chunkPos, &chunk->position, sizeof(struct Vec3i)) != 0) { // If the positions are not equal
-						chunk->position = chunkPos;
-						chunk->isGenerated = true;
-						chunk->isMeshUpToDate = false;
-						generatePerlinTerrain(chunk);
-						//printf("Generated at: %i, %i, %i\n", x, y, z);
-						//printf("Mempos at: %i, %i, %i\n", memPos.x, memPos.y, memPos.z);
+					if(!isWithinRadius(chunkPos, chp, radius)) continue;
+
+					if(!findChunk(world, chunkPos)) {
+						struct Chunk* chunk = addChunk(world, chunkPos);
+						chunk->isQueued = true;
+						queueGeneration(generator, chunkPos);
+						//printf("Queued at: %i, %i, %i\n", x, y, z);
 					}
 				}
 			}
 		}
 
 		// Loop through chunks in a range 1 less than the generated terrain
-		for(int x = chp.x - (int) BGL_LoadRadius + 1; x < chp.x + (int) BGL_LoadRadius; x++) {
-			for (int y = chp.y - (int) BGL_LoadRadius + 1; y < chp.y + (int) BGL_LoadRadius; y++) {
-				for (int z = chp.z - (int) BGL_LoadRadius + 1; z < chp.z + (int) BGL_LoadRadius; z++) {
+		struct Vec3i drawRadius = world->viewRadius;
+		findVisibleChunks(world, &frustum, chp, drawRadius);
+		unsigned int drawnChunks = 0, culledChunks = 0, occludedChunks = 0;
+		for(int x = chp.x - drawRadius.x; x <= chp.x + drawRadius.x; x++) {
+			for (int y = chp.y - drawRadius.y; y <= chp.y + drawRadius.y; y++) {
+				for (int z = chp.z - drawRadius.z; z <= chp.z + drawRadius.z; z++) {
 					struct Vec3i chunkPos;
 					set(&chunkPos, x, y, z);
-					struct Vec3i memPos = toMemoryPos(chunkPos);
-					struct Chunk* chunk = &world->chunks[memPos.x][memPos.y][memPos.z];
+					if(!isWithinRadius(chunkPos, chp, drawRadius)) continue;
+					struct Chunk* chunk = findChunk(world, chunkPos);
+					if(!chunk) continue;
 
-					if(!chunk->isMeshUpToDate) {
-						generateMesh(world, chunk);
+					if(!chunk->isMeshUpToDate && isChunkMeshable(world, chunkPos)) {
+						queueMesh(mesher, world, chunk);
 						chunk->isMeshUpToDate = true;
 					}
 
 					if(!chunk->noMesh) {
+						if(!isChunkInFrustum(&frustum, chunkPos, chunkSize)) {
+							culledChunks++;
+							continue;
+						}
+						if(chunk->visibleFrame != world->visibilityFrame) {
+							occludedChunks++;
+							continue;
+						}
+						drawnChunks++;
 						//printf("Drawing: %i, %i, %i. Indices: %i\n", x, y, z, chunk->indicesSize);
-						glBindVertexArray(chunk->VAO);
-						glDrawElements(GL_TRIANGLES, chunk->indicesSize, GL_UNSIGNED_INT, 0);
-						glBindVertexArray(0);
+						addChunkDraw(world, chunk, camera.position);
 					}
 				}
 			}
 		}
+		glUniform3i(cameraChunk_location, chp.x, chp.y, chp.z);
+		glUniform1i(chunkSize_location, chunkSize);
+		countFrameStats(&stats, world, DT, drawnChunks, culledChunks, occludedChunks);
+		drawChunkList(world);
+		endUploadFrame(&world->uploads);
+		printFrameStats(&stats, world);
 
 		GLenum err;
 		while ((err = glGetError()) != GL_NO_ERROR) {
@@ -193,6 +301,17 @@ int main(void) {
 		glfwPollEvents();
 	}
 
+	deinitMesher(mesher);
+	free(mesher);
+	deinitGenerator(generator);
+	free(generator);
+	if(store) {
+		deinitRegionStore(store);
+		free(store);
+	}
+	deinitEditLog(editLog);
+	free(editLog);
+	deinitWorld(world);
 	free(world);
 	glfwDestroyWindow(window);
 	glfwTerminate();
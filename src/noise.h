@@ -0,0 +1,452 @@
+#ifndef BLOCKGL_NOISE_H
+#define BLOCKGL_NOISE_H
+
+/*
+ * Batch evaluation of stb_perlin_turbulence_noise3() for many points at once.
+ *
+ * The lanes follow the exact sequence of float operations of stb_perlin.h and use the same permutation and gradient
+ * tables, so the results match the scalar path bit for bit unless the compiler contracts multiply-adds into FMA
+ * instructions. Even then the difference stays below BGL_NoiseTolerance per sample.
+ * Wrapping is not supported, which is the same as passing 0 for the wrap arguments of stb_perlin.
+ *
+ * An AVX2 kernel (8 lanes, hardware gathers) is chosen at runtime when the CPU supports it, otherwise an SSE2 kernel
+ * (4 lanes) is used on x86-64. Other architectures fall back to the scalar stb_perlin functions. The AVX2 kernel is
+ * bound by its table gathers, so it fetches neighbouring corners in pairs and has a cheaper path for the y = 0 plane
+ * that terrain heightmaps sample.
+ */
+
+#define BGL_NoiseTolerance 1e-5f
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BGL_NOISE_SIMD
+#include <immintrin.h>
+#endif
+
+#ifdef BGL_NOISE_SIMD
+
+// stb__perlin_randtab widened to 32 bits so it can be gathered
+static int noise_randtab[512];
+// Gradient of stb__perlin_grad(stb__perlin_randtab[i], ...) folded into the last permutation lookup.
+// Bits 0-2 are set when the x, y or z component is nonzero, bits 3-5 when it is negative
+static int noise_gradCode[512];
+// The same tables with entry i + 1 in the high bits, so one gather fetches both corners along an axis. Lattice
+// coordinates wrap at 256 and stb__perlin_randtab repeats after 256 entries, so entry i + 1 is the one for the next
+// corner even where the coordinate wraps back to 0
+static int noise_randPair[512];
+static int noise_gradPair[512];
+static bool noise_hasAVX2;
+static pthread_once_t noise_initOnce = PTHREAD_ONCE_INIT;
+
+static void initNoiseTables(void) {
+	static const float basis[12][3] = {
+			{ 1, 1, 0}, {-1, 1, 0}, { 1,-1, 0}, {-1,-1, 0},
+			{ 1, 0, 1}, {-1, 0, 1}, { 1, 0,-1}, {-1, 0,-1},
+			{ 0, 1, 1}, { 0,-1, 1}, { 0, 1,-1}, { 0,-1,-1},
+	};
+	static const unsigned char indices[64] = {
+			0,1,2,3,4,5,6,7,8,9,10,11,
+			0,9,1,11,
+			0,1,2,3,4,5,6,7,8,9,10,11,
+			0,1,2,3,4,5,6,7,8,9,10,11,
+			0,1,2,3,4,5,6,7,8,9,10,11,
+			0,1,2,3,4,5,6,7,8,9,10,11,
+	};
+
+	for(int i = 0; i < 512; i++) {
+		noise_randtab[i] = stb__perlin_randtab[i];
+		const float* grad = basis[indices[stb__perlin_randtab[i] & 63]];
+		int code = 0;
+		for(int c = 0; c < 3; c++) {
+			if(grad[c] != 0) code |= 1 << c;
+			if(grad[c] < 0) code |= 8 << c;
+		}
+		noise_gradCode[i] = code;
+	}
+	for(int i = 0; i < 511; i++) {
+		noise_randPair[i] = noise_randtab[i] | noise_randtab[i + 1] << 16;
+		noise_gradPair[i] = noise_gradCode[i] | noise_gradCode[i + 1] << 8;
+	}
+
+	__builtin_cpu_init();
+	noise_hasAVX2 = __builtin_cpu_supports("avx2");
+}
+
+/*
+ * AVX2 kernel
+ */
+__attribute__((target("avx2")))
+static inline __m256 noiseEase8(__m256 a) {
+	// (((a*6-15)*a + 10) * a * a * a)
+	__m256 r = _mm256_sub_ps(_mm256_mul_ps(a, _mm256_set1_ps(6)), _mm256_set1_ps(15));
+	r = _mm256_add_ps(_mm256_mul_ps(r, a), _mm256_set1_ps(10));
+	return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(r, a), a), a);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 noiseLerp8(__m256 a, __m256 b, __m256 t) {
+	return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t));
+}
+
+// One gradient component: +v, -v or 0 depending on the code bits. Zero components give +0 where stb_perlin gives
+// 0 * v, which only differs in the sign of zero and is removed by the final fabs()
+__attribute__((target("avx2")))
+static inline __m256 noiseGradComponent8(__m256i code, __m256 v, int component) {
+	__m256i nonzero = _mm256_cmpeq_epi32(_mm256_and_si256(code, _mm256_set1_epi32(1 << component)), _mm256_set1_epi32(1 << component));
+	__m256i sign = _mm256_slli_epi32(_mm256_srli_epi32(code, 3 + component), 31);
+	return _mm256_and_ps(_mm256_xor_ps(v, _mm256_castsi256_ps(sign)), _mm256_castsi256_ps(nonzero));
+}
+
+__attribute__((target("avx2")))
+static inline __m256 noiseGrad8(__m256i code, __m256 x, __m256 y, __m256 z) {
+	__m256 gx = noiseGradComponent8(code, x, 0);
+	__m256 gy = noiseGradComponent8(code, y, 1);
+	__m256 gz = noiseGradComponent8(code, z, 2);
+	return _mm256_add_ps(_mm256_add_ps(gx, gy), gz);
+}
+
+// Permutation entries index and index + 1 in the low and high 16 bits
+__attribute__((target("avx2")))
+static inline __m256i noisePermPair8(__m256i index) {
+	return _mm256_i32gather_epi32(noise_randPair, index, 4);
+}
+
+// Gradient codes of index and index + 1 in bits 0-7 and 8-15
+__attribute__((target("avx2")))
+static inline __m256i noiseGradPair8(__m256i index) {
+	return _mm256_i32gather_epi32(noise_gradPair, index, 4);
+}
+
+__attribute__((target("avx2"), always_inline))
+static inline __m256 perlinNoise8(__m256 x, __m256 y, __m256 z) {
+	const __m256i mask = _mm256_set1_epi32(255);
+	const __m256i lowHalf = _mm256_set1_epi32(0xffff);
+	const __m256i lowByte = _mm256_set1_epi32(0xff);
+	const __m256 onef = _mm256_set1_ps(1);
+
+	__m256 fx = _mm256_floor_ps(x);
+	__m256 fy = _mm256_floor_ps(y);
+	__m256 fz = _mm256_floor_ps(z);
+	__m256i px = _mm256_cvttps_epi32(fx);
+	__m256i py = _mm256_cvttps_epi32(fy);
+	__m256i pz = _mm256_cvttps_epi32(fz);
+	__m256i x0 = _mm256_and_si256(px, mask);
+	__m256i y0 = _mm256_and_si256(py, mask);
+	__m256i z0 = _mm256_and_si256(pz, mask);
+
+	x = _mm256_sub_ps(x, fx);
+	y = _mm256_sub_ps(y, fy);
+	z = _mm256_sub_ps(z, fz);
+	__m256 u = noiseEase8(x);
+	__m256 v = noiseEase8(y);
+	__m256 w = noiseEase8(z);
+
+	// 7 gathers instead of 14: each fetches the pair of corners one step apart along x, y or z
+	__m256i r = noisePermPair8(x0);
+	__m256i r0 = _mm256_and_si256(r, lowHalf);
+	__m256i r1 = _mm256_srli_epi32(r, 16);
+
+	__m256i r0y = noisePermPair8(_mm256_add_epi32(r0, y0));
+	__m256i r1y = noisePermPair8(_mm256_add_epi32(r1, y0));
+	__m256i r00 = _mm256_and_si256(r0y, lowHalf), r01 = _mm256_srli_epi32(r0y, 16);
+	__m256i r10 = _mm256_and_si256(r1y, lowHalf), r11 = _mm256_srli_epi32(r1y, 16);
+
+	__m256i g00 = noiseGradPair8(_mm256_add_epi32(r00, z0));
+	__m256i g01 = noiseGradPair8(_mm256_add_epi32(r01, z0));
+	__m256i g10 = noiseGradPair8(_mm256_add_epi32(r10, z0));
+	__m256i g11 = noiseGradPair8(_mm256_add_epi32(r11, z0));
+
+	__m256 xm = _mm256_sub_ps(x, onef);
+	__m256 ym = _mm256_sub_ps(y, onef);
+	__m256 zm = _mm256_sub_ps(z, onef);
+
+	__m256 n000 = noiseGrad8(_mm256_and_si256(g00, lowByte), x , y , z );
+	__m256 n001 = noiseGrad8(_mm256_srli_epi32(g00, 8), x , y , zm);
+	__m256 n010 = noiseGrad8(_mm256_and_si256(g01, lowByte), x , ym, z );
+	__m256 n011 = noiseGrad8(_mm256_srli_epi32(g01, 8), x , ym, zm);
+	__m256 n100 = noiseGrad8(_mm256_and_si256(g10, lowByte), xm, y , z );
+	__m256 n101 = noiseGrad8(_mm256_srli_epi32(g10, 8), xm, y , zm);
+	__m256 n110 = noiseGrad8(_mm256_and_si256(g11, lowByte), xm, ym, z );
+	__m256 n111 = noiseGrad8(_mm256_srli_epi32(g11, 8), xm, ym, zm);
+
+	__m256 n00 = noiseLerp8(n000, n001, w);
+	__m256 n01 = noiseLerp8(n010, n011, w);
+	__m256 n10 = noiseLerp8(n100, n101, w);
+	__m256 n11 = noiseLerp8(n110, n111, w);
+
+	__m256 n0 = noiseLerp8(n00, n01, v);
+	__m256 n1 = noiseLerp8(n10, n11, v);
+
+	return noiseLerp8(n0, n1, u);
+}
+
+/*
+ * perlinNoise8() for points on the y = 0 plane, which is where terrain columns sample. The y weight is 0 there, so
+ * the y + 1 corners drop out of the interpolation: lerp(a, b, 0) is exactly a, apart from the sign of a zero result
+ * which the final fabs() removes. Half the gradients and gathers are skipped and the result is unchanged.
+ */
+__attribute__((target("avx2"), always_inline))
+static inline __m256 perlinNoisePlane8(__m256 x, __m256 z) {
+	const __m256i mask = _mm256_set1_epi32(255);
+	const __m256i lowHalf = _mm256_set1_epi32(0xffff);
+	const __m256i lowByte = _mm256_set1_epi32(0xff);
+	const __m256 onef = _mm256_set1_ps(1);
+	const __m256 y = _mm256_setzero_ps();
+
+	__m256 fx = _mm256_floor_ps(x);
+	__m256 fz = _mm256_floor_ps(z);
+	__m256i x0 = _mm256_and_si256(_mm256_cvttps_epi32(fx), mask);
+	__m256i z0 = _mm256_and_si256(_mm256_cvttps_epi32(fz), mask);
+
+	x = _mm256_sub_ps(x, fx);
+	z = _mm256_sub_ps(z, fz);
+	__m256 u = noiseEase8(x);
+	__m256 w = noiseEase8(z);
+
+	__m256i r = noisePermPair8(x0);
+	__m256i r00 = _mm256_and_si256(noisePermPair8(_mm256_and_si256(r, lowHalf)), lowHalf);
+	__m256i r10 = _mm256_and_si256(noisePermPair8(_mm256_srli_epi32(r, 16)), lowHalf);
+	__m256i g00 = noiseGradPair8(_mm256_add_epi32(r00, z0));
+	__m256i g10 = noiseGradPair8(_mm256_add_epi32(r10, z0));
+
+	__m256 xm = _mm256_sub_ps(x, onef);
+	__m256 zm = _mm256_sub_ps(z, onef);
+
+	__m256 n000 = noiseGrad8(_mm256_and_si256(g00, lowByte), x , y, z );
+	__m256 n001 = noiseGrad8(_mm256_srli_epi32(g00, 8), x , y, zm);
+	__m256 n100 = noiseGrad8(_mm256_and_si256(g10, lowByte), xm, y, z );
+	__m256 n101 = noiseGrad8(_mm256_srli_epi32(g10, 8), xm, y, zm);
+
+	__m256 n0 = noiseLerp8(n000, n001, w);
+	__m256 n1 = noiseLerp8(n100, n101, w);
+
+	return noiseLerp8(n0, n1, u);
+}
+
+// True when all 8 lanes of y are zero, so the batch lies on the plane perlinNoisePlane8() handles
+__attribute__((target("avx2")))
+static inline bool isNoisePlane8(__m256 y) {
+	return _mm256_testz_si256(_mm256_castps_si256(y), _mm256_castps_si256(y));
+}
+
+__attribute__((target("avx2")))
+static void turbulenceNoiseAVX2(float* out, const float* x, const float* y, const float* z, int count, float lacunarity, float gain, int octaves) {
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	int i = 0;
+	// Two independent vectors per iteration to keep more gathers in flight
+	for(; i + 16 <= count; i += 16) {
+		__m256 px0 = _mm256_loadu_ps(x + i), px1 = _mm256_loadu_ps(x + i + 8);
+		__m256 py0 = _mm256_loadu_ps(y + i), py1 = _mm256_loadu_ps(y + i + 8);
+		__m256 pz0 = _mm256_loadu_ps(z + i), pz1 = _mm256_loadu_ps(z + i + 8);
+		float frequency = 1.0f;
+		float amplitude = 1.0f;
+		__m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+		bool plane = isNoisePlane8(_mm256_or_ps(py0, py1));
+		for(int o = 0; o < octaves; o++) {
+			__m256 f = _mm256_set1_ps(frequency);
+			__m256 a = _mm256_set1_ps(amplitude);
+			__m256 r0, r1;
+			if(plane) {
+				r0 = perlinNoisePlane8(_mm256_mul_ps(px0, f), _mm256_mul_ps(pz0, f));
+				r1 = perlinNoisePlane8(_mm256_mul_ps(px1, f), _mm256_mul_ps(pz1, f));
+			} else {
+				r0 = perlinNoise8(_mm256_mul_ps(px0, f), _mm256_mul_ps(py0, f), _mm256_mul_ps(pz0, f));
+				r1 = perlinNoise8(_mm256_mul_ps(px1, f), _mm256_mul_ps(py1, f), _mm256_mul_ps(pz1, f));
+			}
+			sum0 = _mm256_add_ps(sum0, _mm256_and_ps(_mm256_mul_ps(r0, a), absMask));
+			sum1 = _mm256_add_ps(sum1, _mm256_and_ps(_mm256_mul_ps(r1, a), absMask));
+			frequency *= lacunarity;
+			amplitude *= gain;
+		}
+		_mm256_storeu_ps(out + i, sum0);
+		_mm256_storeu_ps(out + i + 8, sum1);
+	}
+	for(; i + 8 <= count; i += 8) {
+		__m256 px = _mm256_loadu_ps(x + i);
+		__m256 py = _mm256_loadu_ps(y + i);
+		__m256 pz = _mm256_loadu_ps(z + i);
+		float frequency = 1.0f;
+		float amplitude = 1.0f;
+		__m256 sum = _mm256_setzero_ps();
+		bool plane = isNoisePlane8(py);
+		for(int o = 0; o < octaves; o++) {
+			__m256 f = _mm256_set1_ps(frequency);
+			__m256 r = plane ? perlinNoisePlane8(_mm256_mul_ps(px, f), _mm256_mul_ps(pz, f)) :
+							   perlinNoise8(_mm256_mul_ps(px, f), _mm256_mul_ps(py, f), _mm256_mul_ps(pz, f));
+			r = _mm256_mul_ps(r, _mm256_set1_ps(amplitude));
+			sum = _mm256_add_ps(sum, _mm256_and_ps(r, absMask));
+			frequency *= lacunarity;
+			amplitude *= gain;
+		}
+		_mm256_storeu_ps(out + i, sum);
+	}
+	for(; i < count; i++) {
+		out[i] = stb_perlin_turbulence_noise3(x[i], y[i], z[i], lacunarity, gain, octaves, 0, 0, 0);
+	}
+}
+
+/*
+ * SSE2 kernel. SSE2 has no gathers or floor, so the table lookups go through memory lane by lane
+ */
+static inline __m128 noiseFloor4(__m128 a) {
+	__m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+	return _mm_sub_ps(t, _mm_and_ps(_mm_cmplt_ps(a, t), _mm_set1_ps(1)));
+}
+
+static inline __m128 noiseEase4(__m128 a) {
+	__m128 r = _mm_sub_ps(_mm_mul_ps(a, _mm_set1_ps(6)), _mm_set1_ps(15));
+	r = _mm_add_ps(_mm_mul_ps(r, a), _mm_set1_ps(10));
+	return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(r, a), a), a);
+}
+
+static inline __m128 noiseLerp4(__m128 a, __m128 b, __m128 t) {
+	return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+static inline __m128 noiseGradComponent4(__m128i code, __m128 v, int component) {
+	__m128i nonzero = _mm_cmpeq_epi32(_mm_and_si128(code, _mm_set1_epi32(1 << component)), _mm_set1_epi32(1 << component));
+	__m128i sign = _mm_slli_epi32(_mm_srli_epi32(code, 3 + component), 31);
+	return _mm_and_ps(_mm_xor_ps(v, _mm_castsi128_ps(sign)), _mm_castsi128_ps(nonzero));
+}
+
+static inline __m128 noiseGrad4(const int index[4], __m128 x, __m128 y, __m128 z) {
+	__m128i code = _mm_setr_epi32(noise_gradCode[index[0]], noise_gradCode[index[1]], noise_gradCode[index[2]], noise_gradCode[index[3]]);
+	__m128 gx = noiseGradComponent4(code, x, 0);
+	__m128 gy = noiseGradComponent4(code, y, 1);
+	__m128 gz = noiseGradComponent4(code, z, 2);
+	return _mm_add_ps(_mm_add_ps(gx, gy), gz);
+}
+
+static __m128 perlinNoise4(__m128 x, __m128 y, __m128 z) {
+	__m128 fx = noiseFloor4(x);
+	__m128 fy = noiseFloor4(y);
+	__m128 fz = noiseFloor4(z);
+	int px[4], py[4], pz[4];
+	_mm_storeu_si128((__m128i*)px, _mm_cvttps_epi32(fx));
+	_mm_storeu_si128((__m128i*)py, _mm_cvttps_epi32(fy));
+	_mm_storeu_si128((__m128i*)pz, _mm_cvttps_epi32(fz));
+
+	int h000[4], h001[4], h010[4], h011[4], h100[4], h101[4], h110[4], h111[4];
+	for(int l = 0; l < 4; l++) {
+		int x0 = px[l] & 255, x1 = (px[l] + 1) & 255;
+		int y0 = py[l] & 255, y1 = (py[l] + 1) & 255;
+		int z0 = pz[l] & 255, z1 = (pz[l] + 1) & 255;
+		int r0 = noise_randtab[x0];
+		int r1 = noise_randtab[x1];
+		int r00 = noise_randtab[r0 + y0];
+		int r01 = noise_randtab[r0 + y1];
+		int r10 = noise_randtab[r1 + y0];
+		int r11 = noise_randtab[r1 + y1];
+		h000[l] = r00 + z0;
+		h001[l] = r00 + z1;
+		h010[l] = r01 + z0;
+		h011[l] = r01 + z1;
+		h100[l] = r10 + z0;
+		h101[l] = r10 + z1;
+		h110[l] = r11 + z0;
+		h111[l] = r11 + z1;
+	}
+
+	const __m128 onef = _mm_set1_ps(1);
+	x = _mm_sub_ps(x, fx);
+	y = _mm_sub_ps(y, fy);
+	z = _mm_sub_ps(z, fz);
+	__m128 u = noiseEase4(x);
+	__m128 v = noiseEase4(y);
+	__m128 w = noiseEase4(z);
+	__m128 xm = _mm_sub_ps(x, onef);
+	__m128 ym = _mm_sub_ps(y, onef);
+	__m128 zm = _mm_sub_ps(z, onef);
+
+	__m128 n000 = noiseGrad4(h000, x , y , z );
+	__m128 n001 = noiseGrad4(h001, x , y , zm);
+	__m128 n010 = noiseGrad4(h010, x , ym, z );
+	__m128 n011 = noiseGrad4(h011, x , ym, zm);
+	__m128 n100 = noiseGrad4(h100, xm, y , z );
+	__m128 n101 = noiseGrad4(h101, xm, y , zm);
+	__m128 n110 = noiseGrad4(h110, xm, ym, z );
+	__m128 n111 = noiseGrad4(h111, xm, ym, zm);
+
+	__m128 n00 = noiseLerp4(n000, n001, w);
+	__m128 n01 = noiseLerp4(n010, n011, w);
+	__m128 n10 = noiseLerp4(n100, n101, w);
+	__m128 n11 = noiseLerp4(n110, n111, w);
+
+	__m128 n0 = noiseLerp4(n00, n01, v);
+	__m128 n1 = noiseLerp4(n10, n11, v);
+
+	return noiseLerp4(n0, n1, u);
+}
+
+static void turbulenceNoiseSSE2(float* out, const float* x, const float* y, const float* z, int count, float lacunarity, float gain, int octaves) {
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	int i = 0;
+	for(; i + 4 <= count; i += 4) {
+		__m128 px = _mm_loadu_ps(x + i);
+		__m128 py = _mm_loadu_ps(y + i);
+		__m128 pz = _mm_loadu_ps(z + i);
+		float frequency = 1.0f;
+		float amplitude = 1.0f;
+		__m128 sum = _mm_setzero_ps();
+		for(int o = 0; o < octaves; o++) {
+			__m128 f = _mm_set1_ps(frequency);
+			__m128 r = perlinNoise4(_mm_mul_ps(px, f), _mm_mul_ps(py, f), _mm_mul_ps(pz, f));
+			r = _mm_mul_ps(r, _mm_set1_ps(amplitude));
+			sum = _mm_add_ps(sum, _mm_and_ps(r, absMask));
+			frequency *= lacunarity;
+			amplitude *= gain;
+		}
+		_mm_storeu_ps(out + i, sum);
+	}
+	for(; i < count; i++) {
+		out[i] = stb_perlin_turbulence_noise3(x[i], y[i], z[i], lacunarity, gain, octaves, 0, 0, 0);
+	}
+}
+
+#endif /* BGL_NOISE_SIMD */
+
+// Implementations of turbulenceNoiseBatch(), exposed so --check and --benchmark-layout can compare them
+enum NoiseKernel {
+	BGL_NoiseScalar, // stb_perlin one point at a time
+	BGL_NoiseSSE2,
+	BGL_NoiseAVX2,
+	BGL_NoiseKernelCount
+};
+
+static const char* noiseKernelNames[BGL_NoiseKernelCount] = {"scalar", "SSE2", "AVX2"};
+
+bool hasNoiseKernel(enum NoiseKernel kernel) {
+#ifdef BGL_NOISE_SIMD
+	pthread_once(&noise_initOnce, initNoiseTables);
+	return kernel != BGL_NoiseAVX2 || noise_hasAVX2;
+#else
+	return kernel == BGL_NoiseScalar;
+#endif
+}
+
+// turbulenceNoiseBatch() with the given kernel, which hasNoiseKernel() must have accepted
+void turbulenceNoiseKernel(enum NoiseKernel kernel, float* out, const float* x, const float* y, const float* z, int count,
+						   float lacunarity, float gain, int octaves) {
+#ifdef BGL_NOISE_SIMD
+	pthread_once(&noise_initOnce, initNoiseTables);
+	if(kernel == BGL_NoiseAVX2) {
+		turbulenceNoiseAVX2(out, x, y, z, count, lacunarity, gain, octaves);
+		return;
+	}
+	if(kernel == BGL_NoiseSSE2) {
+		turbulenceNoiseSSE2(out, x, y, z, count, lacunarity, gain, octaves);
+		return;
+	}
+#endif
+	for(int i = 0; i < count; i++) {
+		out[i] = stb_perlin_turbulence_noise3(x[i], y[i], z[i], lacunarity, gain, octaves, 0, 0, 0);
+	}
+}
+
+// out[i] = stb_perlin_turbulence_noise3(x[i], y[i], z[i], lacunarity, gain, octaves, 0, 0, 0) for i < count
+void turbulenceNoiseBatch(float* out, const float* x, const float* y, const float* z, int count, float lacunarity, float gain, int octaves) {
+	enum NoiseKernel kernel = BGL_NoiseAVX2;
+	while(!hasNoiseKernel(kernel)) kernel--;
+	turbulenceNoiseKernel(kernel, out, x, y, z, count, lacunarity, gain, octaves);
+}
+
+#endif /* BLOCKGL_NOISE_H */
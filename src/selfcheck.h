@@ -0,0 +1,602 @@
+#ifndef BLOCKGL_SELFCHECK_H
+#define BLOCKGL_SELFCHECK_H
+
+/*
+ * Headless checks run by blockgl --check. They need no window or GL context and cover what can be verified without
+ * drawing, starting with the chunk kernels of every size.
+ */
+
+// Prints the failed condition and counts it in the failures variable of the calling check
+#define BGL_Check(condition, ...) do { \
+		if(!(condition)) { \
+			printf(" - Failed: " __VA_ARGS__); \
+			printf("\n"); \
+			failures++; \
+		} \
+	} while(0)
+
+#define BGL_KernelCount (sizeof(chunkKernels) / sizeof(chunkKernels[0]))
+
+// The layout of the build maps the blocks of a chunk one to one onto indices, and blockPosition() inverts it
+unsigned int checkBlockLayout() {
+	unsigned int failures = 0;
+	for(unsigned int k = 0; k < BGL_KernelCount; k++) {
+		unsigned int size = chunkKernels[k]->size;
+		unsigned int volume = size * size * size;
+		bool* isUsed = calloc(volume, sizeof(bool));
+		unsigned int errors = 0;
+		for(int x = 0; x < (int) size; x++) for(int y = 0; y < (int) size; y++) for(int z = 0; z < (int) size; z++) {
+			unsigned int index = blockIndex(size, x, y, z);
+			if(index >= volume || isUsed[index]) {
+				errors++;
+				continue;
+			}
+			isUsed[index] = true;
+			int position[3];
+			blockPosition(index, size, position);
+			if(position[0] != x || position[1] != y || position[2] != z) errors++;
+		}
+		BGL_Check(errors == 0, "layout " BGL_LayoutName ", chunk size %u: %u blocks don't round trip", size, errors);
+		free(isUsed);
+	}
+	return failures;
+}
+
+// Snapshot of the blocks with an air halo, like copyMeshInput() without neighbours
+void fillMeshInput(struct MeshInput* input, const struct BlockStorage* blocks) {
+	unsigned int size = input->size, padded = size + 2;
+	memset(input->ids, 0, padded * padded * padded * sizeof(unsigned short));
+	input->isUniform = blocks->bits == 0;
+	input->uniformId = blocks->palette[0];
+	for(unsigned int x = 0; x < size; x++) for(unsigned int y = 0; y < size; y++) for(unsigned int z = 0; z < size; z++) {
+		input->ids[((x + 1) * padded + y + 1) * padded + z + 1] = getStorageId(blocks, blockIndex(size, x, y, z));
+	}
+}
+
+// Block faces between a solid block and air, the halo included
+unsigned long countVisibleFaces(const struct MeshInput* input) {
+	unsigned int size = input->size, padded = size + 2;
+	unsigned long faces = 0;
+	for(unsigned int x = 1; x <= size; x++) for(unsigned int y = 1; y <= size; y++) for(unsigned int z = 1; z <= size; z++) {
+		const unsigned short* block = &input->ids[(x * padded + y) * padded + z];
+		if(*block == 0) continue;
+		faces += (block[padded * padded] == 0) + (block[-(int)(padded * padded)] == 0) + (block[padded] == 0) +
+				 (block[-(int) padded] == 0) + (block[1] == 0) + (block[-1] == 0);
+	}
+	return faces;
+}
+
+// Block faces covered by the quads of a mesh, read back from the corner positions of the vertices
+unsigned long countMeshFaces(const struct MeshBuilder* mesh) {
+	unsigned long faces = 0;
+	for(unsigned int quad = 0; quad < mesh->quadCount; quad++) {
+		const GLuint* vertices = &mesh->vertices[quad * 8];
+		int axis = (vertices[0] >> 21 & 7) / 2;
+		unsigned long area = 1;
+		for(int a = 0; a < 3; a++) {
+			if(a == axis) continue;
+			int lo = 127, hi = 0;
+			for(int j = 0; j < 4; j++) {
+				int corner = vertices[j * 2] >> (a * 7) & 127;
+				if(corner < lo) lo = corner;
+				if(corner > hi) hi = corner;
+			}
+			area *= hi - lo;
+		}
+		faces += area;
+	}
+	return faces;
+}
+
+/*
+ * Terrain is the same whichever chunk size generates it, and every mesher covers exactly the visible block faces.
+ * The box of BGL_MaxChunkSize blocks at the origin holds the surface, so its chunks have a mix of blocks at every size.
+ */
+unsigned int checkChunkKernels() {
+	unsigned int failures = 0;
+	const unsigned int box = BGL_MaxChunkSize;
+	unsigned char* reference = malloc(box * box * box);
+	struct ChunkScratch scratch;
+	initChunkScratch(&scratch);
+	struct MeshBuilder mesh;
+	initMeshBuilder(&mesh);
+	struct Heightmap map;
+
+	for(unsigned int k = 0; k <= BGL_KernelCount; k++) {
+		// The default size goes first and fills the reference the others are compared against
+		const struct ChunkKernels* kernels = k == 0 ? getChunkKernels(BGL_DefaultChunkSize) : chunkKernels[k - 1];
+		if(k > 0 && kernels->size == BGL_DefaultChunkSize) continue;
+		unsigned int size = kernels->size, count = box / size;
+		reserveChunkScratch(&scratch, size);
+		struct MeshInput* input = allocMeshInput(size);
+		unsigned int blockErrors = 0, meshErrors = 0;
+		for(unsigned int cx = 0; cx < count; cx++) for(unsigned int cz = 0; cz < count; cz++) {
+			kernels->generateHeightmap(&map, cx, cz);
+			for(unsigned int cy = 0; cy < count; cy++) {
+				struct Vec3i position = {cx, cy, cz};
+				struct BlockStorage blocks;
+				kernels->generateChunkBlocks(&map, position, &blocks, &scratch);
+				for(unsigned int x = 0; x < size; x++) for(unsigned int y = 0; y < size; y++) for(unsigned int z = 0; z < size; z++) {
+					unsigned short id = getStorageId(&blocks, blockIndex(size, x, y, z));
+					unsigned char* expected = &reference[((cx * size + x) * box + cy * size + y) * box + cz * size + z];
+					if(k == 0) {
+						*expected = id;
+					} else if(*expected != id) {
+						blockErrors++;
+					}
+				}
+
+				fillMeshInput(input, &blocks);
+				unsigned long visibleFaces = countVisibleFaces(input);
+				for(int mode = 0; mode < BGL_MeshModeCount; mode++) {
+					resetMeshBuilder(&mesh);
+					kernels->buildMesh[mode](input, &mesh);
+					if(countMeshFaces(&mesh) != visibleFaces) meshErrors++;
+					if(mode != BGL_MeshGreedy && mesh.quadCount != visibleFaces) meshErrors++;
+				}
+				deinitBlockStorage(&blocks);
+			}
+		}
+		if(k > 0) BGL_Check(blockErrors == 0, "chunk size %u: %u blocks differ from chunk size %u", size, blockErrors, BGL_DefaultChunkSize);
+		BGL_Check(meshErrors == 0, "chunk size %u: %u meshes don't cover the visible faces", size, meshErrors);
+		free(input);
+	}
+
+	deinitMeshBuilder(&mesh);
+	deinitChunkScratch(&scratch);
+	free(reference);
+	return failures;
+}
+
+/*
+ * A checkerboard of solid blocks and air shows every face of every block, the largest mesh a chunk can have. At chunk
+ * size 64 it is several times the size of an upload ring section.
+ */
+unsigned int checkWorstCaseMeshes() {
+	unsigned int failures = 0;
+	struct MeshBuilder mesh;
+	initMeshBuilder(&mesh);
+	for(unsigned int k = 0; k < BGL_KernelCount; k++) {
+		unsigned int size = chunkKernels[k]->size, padded = size + 2;
+		struct MeshInput* input = allocMeshInput(size);
+		GLuint* sorted = malloc(BGL_MaxFaces(size) * BGL_QuadBytes);
+		for(unsigned int x = 1; x <= size; x++) for(unsigned int y = 1; y <= size; y++) for(unsigned int z = 1; z <= size; z++) {
+			input->ids[(x * padded + y) * padded + z] = (x + y + z) % 2;
+		}
+		for(int mode = 0; mode < BGL_MeshModeCount; mode++) {
+			resetMeshBuilder(&mesh);
+			chunkKernels[k]->buildMesh[mode](input, &mesh);
+			BGL_Check(mesh.quadCount == BGL_MaxFaces(size) && countMeshFaces(&mesh) == BGL_MaxFaces(size),
+					  "chunk size %u, mesh mode %d: %u quads for a checkerboard instead of %u", size, mode, mesh.quadCount, BGL_MaxFaces(size));
+			if(mesh.quadCount > BGL_MaxFaces(size)) continue;
+			unsigned int faceOffsets[7], errors = 0;
+			sortQuadsByFace(&mesh, sorted, faceOffsets);
+			for(int i = 0; i < 6; i++) {
+				errors += faceOffsets[i + 1] - faceOffsets[i] != BGL_MaxFaces(size) / 6;
+			}
+			BGL_Check(errors == 0, "chunk size %u, mesh mode %d: %u checkerboard face groups have the wrong size", size, mode, errors);
+		}
+		free(sorted);
+		free(input);
+	}
+	deinitMeshBuilder(&mesh);
+	return failures;
+}
+
+#define BGL_CheckNoisePoints 256
+
+/*
+ * Every noise kernel the CPU runs stays within BGL_NoiseTolerance of stb_perlin, for counts ending in each of the tails
+ * of the wide loops, on the y = 0 plane, off it, and with only a few lanes off it
+ */
+unsigned int checkNoise() {
+	unsigned int failures = 0;
+	static const char* const planeNames[] = {"y = 0", "random y", "y = 0 in most lanes"};
+	float x[BGL_CheckNoisePoints], y[BGL_CheckNoisePoints], z[BGL_CheckNoisePoints], out[BGL_CheckNoisePoints];
+	uint32_t random = 5;
+	for(enum NoiseKernel kernel = BGL_NoiseScalar; kernel < BGL_NoiseKernelCount; kernel++) {
+		if(!hasNoiseKernel(kernel)) {
+			printf(" - %s noise isn't supported here\n", noiseKernelNames[kernel]);
+			continue;
+		}
+		for(int plane = 0; plane < 3; plane++) {
+			// Spans negative coordinates and lattice cells well past the 256 the tables wrap at
+			for(int i = 0; i < BGL_CheckNoisePoints; i++) {
+				random = random * 1664525u + 1013904223u;
+				x[i] = (float)(random >> 8) / (1 << 24) * 600 - 300;
+				random = random * 1664525u + 1013904223u;
+				z[i] = (float)(random >> 8) / (1 << 24) * 600 - 300;
+				random = random * 1664525u + 1013904223u;
+				y[i] = plane == 1 || (plane == 2 && i % 9 == 4) ? (float)(random >> 8) / (1 << 24) * 20 - 10 : 0;
+			}
+			unsigned int errors = 0;
+			float worst = 0;
+			// Every count up to 40 ends in each tail of the 16 and 8 lane loops
+			for(int c = 1; c <= 41; c++) {
+				int count = c <= 40 ? c : BGL_CheckNoisePoints;
+				turbulenceNoiseKernel(kernel, out, x, y, z, count, 1.3f, 0.8f, 6);
+				for(int i = 0; i < count; i++) {
+					float difference = fabsf(out[i] - stb_perlin_turbulence_noise3(x[i], y[i], z[i], 1.3f, 0.8f, 6, 0, 0, 0));
+					if(!(difference <= BGL_NoiseTolerance)) errors++;
+					if(difference > worst) worst = difference;
+				}
+			}
+			BGL_Check(errors == 0, "%s noise, %s: %u samples off stb_perlin by up to %g", noiseKernelNames[kernel],
+					  planeNames[plane], errors, worst);
+		}
+	}
+	return failures;
+}
+
+// Blocks with ids below distinct, in runs of random length so the encoding sees both repeats and literals
+void fillCheckBlocks(struct Block* blocks, unsigned int volume, unsigned int distinct, uint32_t* random) {
+	unsigned short id = 0;
+	for(unsigned int i = 0; i < volume; i++) {
+		*random = *random * 1664525u + 1013904223u;
+		if((*random >> 24) < 40) id = (*random >> 8) % distinct;
+		blocks[i].id = id;
+	}
+}
+
+unsigned int countStorageDifferences(const struct BlockStorage* a, const struct BlockStorage* b) {
+	if(a->size != b->size) return storageVolume(a);
+	unsigned int differences = 0;
+	for(unsigned int i = 0; i < storageVolume(a); i++) {
+		differences += getStorageId(a, i) != getStorageId(b, i);
+	}
+	return differences;
+}
+
+// Stored payloads decode to the same blocks at every index width, and damaged ones are rejected
+unsigned int checkChunkEncoding() {
+	unsigned int failures = 0;
+	uint32_t random = 1;
+	for(unsigned int k = 0; k < BGL_KernelCount; k++) {
+		unsigned int size = chunkKernels[k]->size;
+		unsigned int volume = size * size * size;
+		struct Block* blocks = malloc(volume * sizeof(struct Block));
+		const unsigned int distincts[] = {1, 2, 3, 5, BGL_BlockCount};
+		for(unsigned int d = 0; d < sizeof(distincts) / sizeof(distincts[0]); d++) {
+			fillCheckBlocks(blocks, volume, distincts[d], &random);
+			struct BlockStorage storage, decoded;
+			storage.palette = NULL;
+			storage.words = NULL;
+			packBlockStorage(&storage, size, blocks);
+			uint32_t payloadSize;
+			uint8_t* payload = encodeChunk(&storage, &payloadSize);
+
+			bool isDecoded = decodeChunk(payload, payloadSize, size, &decoded);
+			BGL_Check(isDecoded, "chunk size %u, %u bits: payload doesn't decode", size, storage.bits);
+			if(isDecoded) {
+				BGL_Check(decoded.bits == storage.bits && countStorageDifferences(&storage, &decoded) == 0,
+						  "chunk size %u, %u bits: decoded blocks differ", size, storage.bits);
+				deinitBlockStorage(&decoded);
+			}
+			isDecoded = decodeChunk(payload, payloadSize - 1, size, &decoded);
+			BGL_Check(!isDecoded, "chunk size %u, %u bits: truncated payload decodes", size, storage.bits);
+			if(isDecoded) deinitBlockStorage(&decoded);
+
+			if(storage.bits > 0) {
+				// Repeat runs that end one word past the chunk
+				size_t headerSize = sizeof(struct StoredChunk) + storage.paletteSize * sizeof(uint16_t);
+				uint8_t* overflow = malloc(payloadSize + volume * 6);
+				memcpy(overflow, payload, headerSize);
+				uint8_t* out = overflow + headerSize;
+				for(unsigned int left = volume * storage.bits / 32 + 1; left > 0;) {
+					uint16_t token = 0x8000 | (left < 0x7fff ? left : 0x7fff);
+					uint32_t word = 0;
+					memcpy(out, &token, sizeof(token));
+					memcpy(out + sizeof(token), &word, sizeof(word));
+					out += sizeof(token) + sizeof(word);
+					left -= token & 0x7fff;
+				}
+				isDecoded = decodeChunk(overflow, out - overflow, size, &decoded);
+				BGL_Check(!isDecoded, "chunk size %u, %u bits: payload with a run past the chunk decodes", size, storage.bits);
+				if(isDecoded) deinitBlockStorage(&decoded);
+				free(overflow);
+			}
+
+			uint16_t badId = BGL_BlockCount;
+			memcpy(payload + sizeof(struct StoredChunk), &badId, sizeof(badId));
+			isDecoded = decodeChunk(payload, payloadSize, size, &decoded);
+			BGL_Check(!isDecoded, "chunk size %u, %u bits: payload with an unknown block id decodes", size, storage.bits);
+			if(isDecoded) deinitBlockStorage(&decoded);
+
+			free(payload);
+			deinitBlockStorage(&storage);
+		}
+		free(blocks);
+	}
+	return failures;
+}
+
+// Chunks written to region files, some of them twice, read back the same once the store is reopened
+unsigned int checkRegionStore(const char* directory) {
+	unsigned int failures = 0;
+	// Spread over three regions, on both sides of the origin
+	const struct Vec3i positions[] = {{0, 0, 0}, {31, 31, 31}, {-1, 2, -33}, {32, 0, 0}, {0, 0, 0}};
+	const unsigned int positionCount = sizeof(positions) / sizeof(positions[0]);
+	uint32_t random = 7;
+	for(unsigned int k = 0; k < BGL_KernelCount; k++) {
+		unsigned int size = chunkKernels[k]->size;
+		unsigned int volume = size * size * size;
+		struct Block* blocks = malloc(volume * sizeof(struct Block));
+		struct BlockStorage stored[sizeof(positions) / sizeof(positions[0])];
+		struct RegionStore store;
+		initRegionStore(&store, directory, size);
+		for(unsigned int i = 0; i < positionCount; i++) {
+			fillCheckBlocks(blocks, volume, 1 + i, &random);
+			stored[i].palette = NULL;
+			stored[i].words = NULL;
+			packBlockStorage(&stored[i], size, blocks);
+			storeChunk(&store, positions[i], &stored[i]);
+		}
+		deinitRegionStore(&store);
+
+		initRegionStore(&store, directory, size);
+		for(unsigned int i = 0; i < positionCount; i++) {
+			// The last write of a position wins
+			bool isOverwritten = false;
+			for(unsigned int j = i + 1; j < positionCount; j++) {
+				if(memcmp(&positions[i], &positions[j], sizeof(struct Vec3i)) == 0) isOverwritten = true;
+			}
+			if(isOverwritten) continue;
+			struct BlockStorage loaded;
+			bool isLoaded = loadStoredChunk(&store, positions[i], &loaded);
+			BGL_Check(isLoaded, "chunk size %u: chunk %i %i %i wasn't stored", size, positions[i].x, positions[i].y, positions[i].z);
+			if(!isLoaded) continue;
+			BGL_Check(countStorageDifferences(&stored[i], &loaded) == 0, "chunk size %u: chunk %i %i %i reads back different blocks",
+					  size, positions[i].x, positions[i].y, positions[i].z);
+			deinitBlockStorage(&loaded);
+		}
+		struct Vec3i missing = {5, 5, 5};
+		struct BlockStorage loaded;
+		bool isLoaded = loadStoredChunk(&store, missing, &loaded);
+		BGL_Check(!isLoaded, "chunk size %u: a chunk that was never stored loads", size);
+		if(isLoaded) deinitBlockStorage(&loaded);
+
+		for(unsigned int i = 0; i < store.regionCount; i++) {
+			char path[300];
+			regionPath(&store, store.regions[i]->position, "", path, sizeof(path));
+			unlink(path);
+		}
+		deinitRegionStore(&store);
+		for(unsigned int i = 0; i < positionCount; i++) {
+			deinitBlockStorage(&stored[i]);
+		}
+		free(blocks);
+	}
+	return failures;
+}
+
+
+// Log an edit of the block at a global position
+void recordCheckEdit(struct EditLog* log, int x, int y, int z, unsigned short id) {
+	int size = log->chunkSize;
+	int local[3] = {modulo(x, size), modulo(y, size), modulo(z, size)};
+	struct Vec3i position = {(x - local[0]) / size, (y - local[1]) / size, (z - local[2]) / size};
+	recordBlockEdit(log, position, blockIndex(size, local[0], local[1], local[2]), id);
+}
+
+// Latest logged id of the block at a global position
+bool findLoggedEdit(const struct EditLog* log, int x, int y, int z, unsigned short* id) {
+	int size = log->chunkSize;
+	int local[3] = {modulo(x, size), modulo(y, size), modulo(z, size)};
+	struct Vec3i position = {(x - local[0]) / size, (y - local[1]) / size, (z - local[2]) / size};
+	const struct ChunkEdits* chunk = probeEditMap(log, position);
+	if(!chunk->edits) return false;
+	unsigned int index = blockIndex(size, local[0], local[1], local[2]);
+	for(unsigned int i = 0; i < chunk->count; i++) {
+		if(chunk->edits[i].index == index) {
+			*id = chunk->edits[i].id;
+			return true;
+		}
+	}
+	return false;
+}
+
+#define BGL_CheckEdits 200
+
+/*
+ * Edits survive reopening the log at every chunk size, a record torn by a crash is dropped so later appends read back,
+ * and a log made mostly of overwritten records is compacted to the latest edit of each block
+ */
+unsigned int checkEditLog(const char* directory) {
+	unsigned int failures = 0;
+	char path[300];
+	snprintf(path, sizeof(path), "%s/" BGL_EditLogFile, directory);
+	int edits[BGL_CheckEdits][4]; // x, y, z and id
+	uint32_t random = 3;
+	for(int i = 0; i < BGL_CheckEdits; i++) {
+		for(int a = 0; a < 3; a++) {
+			random = random * 1664525u + 1013904223u;
+			edits[i][a] = (int)(random >> 8) % 24 - 12; // Small enough that blocks get edited again
+		}
+		edits[i][3] = i % BGL_BlockCount;
+	}
+
+	struct EditLog log;
+	initEditLog(&log, directory, BGL_DefaultChunkSize);
+	for(int i = 0; i < BGL_CheckEdits; i++) {
+		recordCheckEdit(&log, edits[i][0], edits[i][1], edits[i][2], edits[i][3]);
+	}
+	deinitEditLog(&log);
+
+	// A crash in the middle of an append
+	int fd = open(path, O_WRONLY | O_APPEND);
+	BGL_Check(fd >= 0 && write(fd, "torn", 4) == 4, "can't append to %s", path);
+	if(fd >= 0) close(fd);
+
+	for(unsigned int k = 0; k < BGL_KernelCount; k++) {
+		initEditLog(&log, directory, chunkKernels[k]->size);
+		unsigned int errors = 0;
+		for(int i = 0; i < BGL_CheckEdits; i++) {
+			bool isOverwritten = false;
+			for(int j = i + 1; j < BGL_CheckEdits; j++) {
+				if(memcmp(edits[i], edits[j], 3 * sizeof(int)) == 0) isOverwritten = true;
+			}
+			unsigned short id;
+			if(!isOverwritten && (!findLoggedEdit(&log, edits[i][0], edits[i][1], edits[i][2], &id) || id != edits[i][3])) errors++;
+		}
+		BGL_Check(errors == 0, "chunk size %u: %u edits not replayed", chunkKernels[k]->size, errors);
+		// Past the other edits, one more for every reopen
+		recordCheckEdit(&log, 100 + k, 0, 0, 1);
+		deinitEditLog(&log);
+	}
+	initEditLog(&log, directory, BGL_DefaultChunkSize);
+	for(unsigned int k = 0; k < BGL_KernelCount; k++) {
+		unsigned short id;
+		BGL_Check(findLoggedEdit(&log, 100 + k, 0, 0, &id) && id == 1, "edit appended after reopen %u not replayed", k);
+	}
+	deinitEditLog(&log);
+	unlink(path);
+
+	// The same few blocks edited over and over
+	const int blocks = 10, rounds = BGL_EditLogCompactRecords / blocks * 3;
+	initEditLog(&log, directory, BGL_DefaultChunkSize);
+	for(int round = 0; round < rounds; round++) {
+		for(int b = 0; b < blocks; b++) {
+			recordCheckEdit(&log, b * 7 - 30, b, -b, 1 + (round + b) % (BGL_BlockCount - 1));
+		}
+	}
+	deinitEditLog(&log);
+	BGL_Check(log.compactions > 0, "edit log of %i records over %i blocks wasn't compacted", rounds * blocks, blocks);
+	struct stat info;
+	BGL_Check(stat(path, &info) == 0 && (size_t) info.st_size <= sizeof(struct EditLogHeader) +
+			  (BGL_EditLogCompactRecords * 2 + 1) * sizeof(struct EditRecord), "compacted edit log is %ld bytes", (long) info.st_size);
+	initEditLog(&log, directory, BGL_DefaultChunkSize);
+	unsigned int errors = 0;
+	for(int b = 0; b < blocks; b++) {
+		unsigned short id;
+		if(!findLoggedEdit(&log, b * 7 - 30, b, -b, &id) || id != 1 + (rounds - 1 + b) % (BGL_BlockCount - 1)) errors++;
+	}
+	BGL_Check(errors == 0 && log.editCount == (unsigned long) blocks, "compacted edit log lost %u edits", errors);
+	deinitEditLog(&log);
+	unlink(path);
+	return failures;
+}
+
+#define BGL_CheckExploredRadius	4 // Chunks around the origin, horizontally
+#define BGL_CheckExploredHeight	4 // Chunk layers from y = -2
+
+/*
+ * The edit log is the save. It stays a small fraction of what region files take for the terrain of the same area,
+ * which is why that cache is optional
+ */
+unsigned int checkSaveSize(const char* directory) {
+	unsigned int failures = 0;
+	const struct ChunkKernels* kernels = getChunkKernels(BGL_DefaultChunkSize);
+	const int size = kernels->size, radius = BGL_CheckExploredRadius;
+	char terrainDirectory[300];
+	snprintf(terrainDirectory, sizeof(terrainDirectory), "%s/" BGL_TerrainDirectory, directory);
+
+	struct EditLog log;
+	struct RegionStore store;
+	struct HeightmapCache heightmaps;
+	struct ChunkScratch scratch;
+	initEditLog(&log, directory, size);
+	initRegionStore(&store, terrainDirectory, size);
+	initHeightmapCache(&heightmaps, kernels, radius);
+	initChunkScratch(&scratch);
+	reserveChunkScratch(&scratch, size);
+	for(int x = -radius; x <= radius; x++) for(int z = -radius; z <= radius; z++) {
+		struct Heightmap map;
+		getHeightmap(&heightmaps, &map, x, z);
+		for(int y = -2; y < BGL_CheckExploredHeight - 2; y++) {
+			struct Vec3i position = {x, y, z};
+			struct BlockStorage blocks;
+			kernels->generateChunkBlocks(&map, position, &blocks, &scratch);
+			storeChunk(&store, position, &blocks);
+			deinitBlockStorage(&blocks);
+		}
+		// One edit per column
+		recordCheckEdit(&log, x * size, 0, z * size, 1);
+	}
+	deinitChunkScratch(&scratch);
+	deinitHeightmapCache(&heightmaps);
+	deinitRegionStore(&store);
+	deinitEditLog(&log);
+
+	// Every region the area touches
+	struct Vec3i low = toRegionPos((struct Vec3i) {-radius, -2, -radius});
+	struct Vec3i high = toRegionPos((struct Vec3i) {radius, BGL_CheckExploredHeight - 3, radius});
+	unsigned long regionBytes = 0;
+	for(int x = low.x; x <= high.x; x++) for(int y = low.y; y <= high.y; y++) for(int z = low.z; z <= high.z; z++) {
+		char path[300];
+		struct stat info;
+		regionPath(&store, (struct Vec3i) {x, y, z}, "", path, sizeof(path));
+		if(stat(path, &info) == 0) regionBytes += info.st_size;
+		unlink(path);
+	}
+	BGL_Check(log.fileBytes * 100 <= regionBytes, "edit log of %lu bytes isn't much smaller than %lu bytes of region files",
+			  log.fileBytes, regionBytes);
+	printf("Edit log: %lu bytes, region files: %lu bytes for the same area\n", log.fileBytes, regionBytes);
+	unlink(log.path);
+	rmdir(terrainDirectory);
+	return failures;
+}
+
+// An edit log written in another layout is refused and left as it was, like its region files
+unsigned int checkForeignEditLog(const char* directory) {
+	unsigned int failures = 0;
+	char path[300];
+	snprintf(path, sizeof(path), "%s/" BGL_EditLogFile, directory);
+	struct EditLogHeader header = {BGL_EditLogMagic, BGL_EditLogVersion, (BGL_BlockLayout + 1) % (BGL_LayoutMorton + 1)};
+	struct EditRecord record = {1, 2, 3, 1, 0};
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	bool isWritten = fd >= 0 && writeAll(fd, &header, sizeof(header)) && writeAll(fd, &record, sizeof(record));
+	if(fd >= 0) close(fd);
+	BGL_Check(isWritten, "can't write %s", path);
+
+	struct EditLog log;
+	initEditLog(&log, directory, BGL_DefaultChunkSize);
+	BGL_Check(!log.isWritable && log.editCount == 0, "edit log of another layout was read");
+	recordBlockEdit(&log, (struct Vec3i) {0, 0, 0}, 0, 1);
+	deinitEditLog(&log);
+
+	struct stat info;
+	BGL_Check(stat(path, &info) == 0 && (size_t) info.st_size == sizeof(header) + sizeof(record),
+			  "edit log of another layout was changed");
+	unlink(path);
+	return failures;
+}
+
+// Runs every check and prints the failures. Returns whether all of them passed
+bool runSelfChecks() {
+	unsigned int failures = 0;
+	char directory[] = "/tmp/blockgl-check-XXXXXX";
+	if(!mkdtemp(directory)) {
+		printf("Can't create a temporary directory for the checks\n");
+		return false;
+	}
+
+	printf("Checking block layout\n");
+	failures += checkBlockLayout();
+	printf("Checking chunk kernels\n");
+	failures += checkChunkKernels();
+	printf("Checking worst case meshes\n");
+	failures += checkWorstCaseMeshes();
+	printf("Checking noise\n");
+	failures += checkNoise();
+	printf("Checking stored chunk encoding\n");
+	failures += checkChunkEncoding();
+	printf("Checking region files\n");
+	failures += checkRegionStore(directory);
+	printf("Checking edit log\n");
+	failures += checkEditLog(directory);
+	printf("Checking save size\n");
+	failures += checkSaveSize(directory);
+	printf("Checking edit log layout\n");
+	failures += checkForeignEditLog(directory);
+
+	rmdir(directory);
+
+	if(failures > 0) {
+		printf("%u checks failed\n", failures);
+	} else {
+		printf("All checks passed\n");
+	}
+	return failures == 0;
+}
+
+#endif /* BLOCKGL_SELFCHECK_H */